@@ -7,6 +7,7 @@
  * 2. 贪心算法 AI (Level 2)
  * 3. 随机算法 AI (Level 1)
  * 4. 支持 人机对战 和 机机对战 的双向难度自由选择
+ * 5. Alpha-beta 搜索 + NNUE 增量评估 AI (Level 4，黑白棋/五子棋)
  */
 
 #include <iostream>
@@ -26,6 +27,31 @@
 #include <chrono>
 #include <cmath>
 #include <limits>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <filesystem>
+#include <random>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HW2_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -36,7 +62,7 @@ using namespace std;
 enum PieceType { EMPTY = 0, BLACK = 1, WHITE = 2 };
 enum GameType { GOMOKU = 1, GO = 2, REVERSI = 3 };
 enum GameStatus { PLAYING, BLACK_WIN, WHITE_WIN, DRAW };
-enum PlayerType { HUMAN = 0, AI_LEVEL_1 = 1, AI_LEVEL_2 = 2, AI_LEVEL_3 = 3 };
+enum PlayerType { HUMAN = 0, AI_LEVEL_1 = 1, AI_LEVEL_2 = 2, AI_LEVEL_3 = 3, AI_LEVEL_4 = 4 };
 
 struct Point {
     int x, y;
@@ -134,16 +160,82 @@ public:
 // 3. Model 层：棋盘与规则
 // ==========================================
 
+// 棋盘上一个格子的改动 (可撤销着法用)
+struct BoardChange {
+    int x, y;
+    PieceType before, after;
+};
+
 class Board {
 private:
     int size;
     vector<vector<PieceType>> grid;
+    // 各类棋子数量，随 setPiece 增量维护，countPieces 为 O(1) 读取
+    int blackCount, whiteCount, emptyCount;
+    // 改动日志：非空时 setPiece 记下每个实际改动的格子，搜索据此撤销着法并增量更新评估
+    vector<BoardChange>* journal = nullptr;
+    // Zobrist 局面哈希，随 setPiece 增量维护
+    uint64_t hash = 0;
+
+    void rehash() {
+        hash = 0;
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < size; ++j) hash ^= zobrist(i, j, grid[i][j]);
+    }
+
+    void recount() {
+        blackCount = whiteCount = emptyCount = 0;
+        for(auto& row : grid)
+            for(auto p : row) {
+                if(p == BLACK) blackCount++;
+                else if(p == WHITE) whiteCount++;
+                else emptyCount++;
+            }
+    }
+
+    int& counterOf(PieceType p) {
+        if (p == BLACK) return blackCount;
+        if (p == WHITE) return whiteCount;
+        return emptyCount;
+    }
 
 public:
-    Board(int s) : size(s) {
+    static const int MAX_SIZE = 19;
+
+    // (x, y) 处放 p 的 Zobrist 键 (空点为 0)，固定种子生成，各棋盘尺寸共用
+    static uint64_t zobrist(int x, int y, PieceType p) {
+        static const vector<uint64_t> table = [] {
+            vector<uint64_t> t(MAX_SIZE * MAX_SIZE * 2);
+            uint64_t z = 0x243F6A8885A308D3ULL;
+            for (auto& v : t) { // splitmix64
+                z += 0x9E3779B97F4A7C15ULL;
+                uint64_t r = z;
+                r = (r ^ (r >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                r = (r ^ (r >> 27)) * 0x94D049BB133111EBULL;
+                v = r ^ (r >> 31);
+            }
+            return t;
+        }();
+        if (p == EMPTY) return 0;
+        return table[(x * MAX_SIZE + y) * 2 + (p - 1)];
+    }
+
+    Board(int s) : size(s), blackCount(0), whiteCount(0), emptyCount(s * s) {
         grid.resize(size, vector<PieceType>(size, EMPTY));
     }
-    Board(const Board& other) : size(other.size), grid(other.grid) {}
+    // 复制只复制局面，日志属于各自的搜索，不随之复制
+    Board(const Board& other) : size(other.size), grid(other.grid),
+        blackCount(other.blackCount), whiteCount(other.whiteCount), emptyCount(other.emptyCount),
+        hash(other.hash) {}
+    Board& operator=(const Board& other) {
+        size = other.size;
+        grid = other.grid;
+        blackCount = other.blackCount;
+        whiteCount = other.whiteCount;
+        emptyCount = other.emptyCount;
+        hash = other.hash;
+        return *this;
+    }
 
     int getSize() const { return size; }
     
@@ -157,19 +249,43 @@ public:
     }
 
     void setPiece(int x, int y, PieceType p) {
-        if (isValidBounds(x, y)) grid[x][y] = p;
+        if (!isValidBounds(x, y)) return;
+        PieceType& cell = grid[x][y];
+        if (cell == p) return;
+        if (journal) journal->push_back({x, y, cell, p});
+        counterOf(cell)--;
+        counterOf(p)++;
+        hash ^= zobrist(x, y, cell) ^ zobrist(x, y, p);
+        cell = p;
     }
     
     void clear() {
         for (auto& row : grid) fill(row.begin(), row.end(), EMPTY);
+        blackCount = whiteCount = 0;
+        emptyCount = size * size;
+        hash = 0;
+    }
+
+    void setJournal(vector<BoardChange>* j) { journal = j; }
+    vector<BoardChange>* getJournal() const { return journal; }
+    // 按逆序撤销日志中 mark 之后的改动，并截断日志
+    void rollback(size_t mark) {
+        vector<BoardChange>* j = journal;
+        journal = nullptr;
+        for (size_t i = j->size(); i > mark; --i) {
+            const BoardChange& c = (*j)[i - 1];
+            setPiece(c.x, c.y, c.before);
+        }
+        j->resize(mark);
+        journal = j;
     }
 
     int countPieces(PieceType type) const {
-        int count = 0;
-        for(auto& row : grid)
-            for(auto p : row) if(p == type) count++;
-        return count;
+        if (type == BLACK) return blackCount;
+        if (type == WHITE) return whiteCount;
+        return emptyCount;
     }
+    uint64_t getHash() const { return hash; }
 
     string serialize() const {
         stringstream ss;
@@ -190,24 +306,64 @@ public:
                 grid[i][j] = static_cast<PieceType>(temp);
             }
         }
+        recount();
+        rehash();
     }
 };
 
 class GameRule {
 protected:
     Board* board;
+    // 终局状态：由 makeMove 根据最后一手增量维护，status()/isTerminal() 为 O(1) 查询
+    GameStatus gameStatus;
+    int consecutivePasses;
+
+    // 按 calculateScore 的比分判定胜负
+    GameStatus scoreStatus() {
+        float b, w;
+        calculateScore(b, w);
+        if (b > w) return BLACK_WIN;
+        if (w > b) return WHITE_WIN;
+        return DRAW;
+    }
+    // 虚着：双方连续虚着即终局
+    void registerPass() {
+        if (++consecutivePasses >= 2) gameStatus = scoreStatus();
+    }
+    // 从整个棋盘重新推导终局状态 (仅用于 resync，非热点路径)
+    virtual GameStatus recomputeStatus() {
+        return consecutivePasses >= 2 ? scoreStatus() : PLAYING;
+    }
+
 public:
-    GameRule(Board* b) : board(b) {}
+    GameRule(Board* b) : board(b), gameStatus(PLAYING), consecutivePasses(0) {}
     virtual ~GameRule() {}
     
-    // MCTS 关键：原型模式克隆接口
+    // MCTS 关键：原型模式克隆接口 (连同终局状态一起复制)
     virtual GameRule* clone(Board* newBoard) const = 0;
+    // 搜索引擎按值复制具体规则后，改绑到模拟棋盘上
+    void setBoard(Board* b) { board = b; }
 
     virtual bool isValidMove(int x, int y, PieceType player) = 0;
+    // (-1, -1) 表示虚着
     virtual void makeMove(int x, int y, PieceType player) = 0;
-    virtual GameStatus checkWin(int lastX, int lastY) = 0;
     virtual bool supportsPass() const { return false; } 
     virtual void initBoard() {} 
+
+    GameStatus status() const { return gameStatus; }
+    bool isTerminal() const { return gameStatus != PLAYING; }
+    int getPassCount() const { return consecutivePasses; }
+    // 撤销着法时恢复走子前的规则状态 (棋盘本身由 Board::rollback 恢复)
+    void restoreStatus(GameStatus s, int passes) {
+        gameStatus = s;
+        consecutivePasses = passes;
+    }
+
+    // 棋盘被外部整体改写后 (悔棋/读档/回放) 重新同步规则内部状态
+    void resync(int passes) {
+        consecutivePasses = passes;
+        gameStatus = recomputeStatus();
+    }
     
     virtual void calculateScore(float& blackScore, float& whiteScore) {
         blackScore = board->countPieces(BLACK);
@@ -223,24 +379,12 @@ public:
 };
 
 // --- 五子棋规则 ---
-class GomokuRule : public GameRule {
-public:
-    GomokuRule(Board* b) : GameRule(b) {}
-    
-    GameRule* clone(Board* newBoard) const override {
-        return new GomokuRule(newBoard);
-    }
-
-    bool isValidMove(int x, int y, PieceType player) override {
-        return board->isValidBounds(x, y) && board->getPiece(x, y) == EMPTY;
-    }
-    void makeMove(int x, int y, PieceType player) override {
-        board->setPiece(x, y, player);
-    }
-    GameStatus checkWin(int x, int y) override {
-        if (x == -1 && y == -1) return PLAYING;
+class GomokuRule final : public GameRule {
+private:
+    // 以 (x, y) 为端点之一是否连成五子
+    bool formsFive(int x, int y) const {
         PieceType current = board->getPiece(x, y);
-        if (current == EMPTY) return PLAYING;
+        if (current == EMPTY) return false;
         int directions[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
         for (auto& dir : directions) {
             int count = 1;
@@ -252,23 +396,218 @@ public:
                 if (board->getPiece(x - i * dir[0], y - i * dir[1]) == current) count++;
                 else break;
             }
-            if (count >= 5) return (current == BLACK) ? BLACK_WIN : WHITE_WIN;
+            if (count >= 5) return true;
         }
+        return false;
+    }
+
+protected:
+    GameStatus recomputeStatus() override {
         for(int i=0; i<board->getSize(); ++i)
             for(int j=0; j<board->getSize(); ++j)
-                if(board->getPiece(i, j) == EMPTY) return PLAYING;
-        return DRAW;
+                if(formsFive(i, j)) return (board->getPiece(i, j) == BLACK) ? BLACK_WIN : WHITE_WIN;
+        return board->countPieces(EMPTY) == 0 ? DRAW : PLAYING;
+    }
+
+public:
+    GomokuRule(Board* b) : GameRule(b) {}
+    
+    GameRule* clone(Board* newBoard) const override {
+        GomokuRule* r = new GomokuRule(*this);
+        r->board = newBoard;
+        return r;
+    }
+
+    bool isValidMove(int x, int y, PieceType player) override {
+        return board->isValidBounds(x, y) && board->getPiece(x, y) == EMPTY;
+    }
+    void makeMove(int x, int y, PieceType player) override {
+        if (x == -1 && y == -1) { registerPass(); return; }
+        board->setPiece(x, y, player);
+        consecutivePasses = 0;
+        // 只需检查最后一手所在的四条线
+        if (formsFive(x, y)) gameStatus = (player == BLACK) ? BLACK_WIN : WHITE_WIN;
+        else if (board->countPieces(EMPTY) == 0) gameStatus = DRAW;
     }
 };
 
+// Benson 无条件活棋分析 (单色)：color 方即使一直虚着、任凭对方落子也不会被提的棋串，
+// 以及由这些棋串围成且对方无法做活的区域 (区域内的对方棋子是死子)，在 area 中标为 mark。
+// at(x, y) 给出点的颜色 (盘外为 3)，规则对象与死活求解器各自提供
+template<class CellAt>
+void bensonPassAlive(int n, CellAt at, PieceType color, int8_t mark, vector<int8_t>& area) {
+    int N = n * n;
+    static const int dx[] = {0, 0, 1, -1};
+    static const int dy[] = {1, -1, 0, 0};
+    // 工作缓冲按线程保留，随机模拟与死活求解中频繁调用时不再反复分配
+    thread_local vector<int> chainOf, regionOf, points, regionBegin, borderBegin, borderList, libertyHits, vitalCount;
+    thread_local vector<pair<int, int>> vital;
+    thread_local vector<char> chainAlive, regionAlive;
+    chainOf.assign(N, -1);
+    regionOf.assign(N, -1);
+    points.clear();
+    regionBegin.clear();
+    int chains = 0;
+    // 1. 标记 color 方的棋串
+    for (int p = 0; p < N; ++p) {
+        if (chainOf[p] >= 0 || at(p / n, p % n) != color) continue;
+        size_t head = points.size();
+        chainOf[p] = chains;
+        points.push_back(p);
+        for (; head < points.size(); ++head) {
+            int cx = points[head] / n, cy = points[head] % n;
+            for (int k = 0; k < 4; ++k) {
+                int nx = cx + dx[k], ny = cy + dy[k];
+                if (at(nx, ny) != color) continue;
+                if (chainOf[nx * n + ny] < 0) { chainOf[nx * n + ny] = chains; points.push_back(nx * n + ny); }
+            }
+        }
+        chains++;
+    }
+    // 2. 标记区域 (非 color 点的连通块)，并求出相邻棋串及区域对哪些棋串是"要害"
+    //    区域对棋串 X 是要害：区域内每个空点都是 X 的气
+    points.clear();
+    borderBegin.clear();               // 区域 r 的相邻棋串为 borderList[borderBegin[r], borderBegin[r + 1])
+    borderList.clear();
+    vital.clear();                     // (区域, 棋串)
+    libertyHits.assign(chains, 0);
+    int regions = 0;
+    for (int p = 0; p < N; ++p) {
+        if (regionOf[p] >= 0 || at(p / n, p % n) == color) continue;
+        regionBegin.push_back((int)points.size());
+        size_t head = points.size();
+        regionOf[p] = regions;
+        points.push_back(p);
+        borderBegin.push_back((int)borderList.size());
+        auto borderHas = [&](int c) {
+            return find(borderList.begin() + borderBegin.back(), borderList.end(), c) != borderList.end();
+        };
+        int empties = 0;
+        for (; head < points.size(); ++head) {
+            int cx = points[head] / n, cy = points[head] % n;
+            bool empty = at(cx, cy) == EMPTY;
+            if (empty) empties++;
+            int seen[4], seenCount = 0;
+            for (int k = 0; k < 4; ++k) {
+                int nx = cx + dx[k], ny = cy + dy[k];
+                int v = at(nx, ny);
+                if (v == 3) continue;
+                int q = nx * n + ny;
+                if (v == color) {
+                    int c = chainOf[q];
+                    if (!borderHas(c)) borderList.push_back(c);
+                    // 每个空点对同一棋串只计一次
+                    if (empty && find(seen, seen + seenCount, c) == seen + seenCount) {
+                        seen[seenCount++] = c;
+                        libertyHits[c]++;
+                    }
+                } else if (regionOf[q] < 0) {
+                    regionOf[q] = regions;
+                    points.push_back(q);
+                }
+            }
+        }
+        for (size_t i = borderBegin.back(); i < borderList.size(); ++i) {
+            int c = borderList[i];
+            if (libertyHits[c] == empties) vital.push_back({regions, c});
+            libertyHits[c] = 0;
+        }
+        regions++;
+    }
+    regionBegin.push_back((int)points.size());
+    borderBegin.push_back((int)borderList.size());
+
+    // 3. 反复剔除：要害区域少于两个的棋串不活；与不活棋串相邻的区域不再算作要害
+    chainAlive.assign(chains, 1);
+    regionAlive.assign(regions, 1);
+    vitalCount.assign(chains, 0);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        fill(vitalCount.begin(), vitalCount.end(), 0);
+        for (auto& v : vital)
+            if (regionAlive[v.first]) vitalCount[v.second]++;
+        for (int c = 0; c < chains; ++c)
+            if (chainAlive[c] && vitalCount[c] < 2) { chainAlive[c] = false; changed = true; }
+        for (int r = 0; r < regions; ++r) {
+            if (!regionAlive[r]) continue;
+            for (int i = borderBegin[r]; i < borderBegin[r + 1]; ++i)
+                if (!chainAlive[borderList[i]]) { regionAlive[r] = false; changed = true; break; }
+        }
+    }
+
+    // 4. 存活棋串，以及只被存活棋串包围、且每个空点都紧贴 color 方棋子的区域
+    for (int p = 0; p < N; ++p)
+        if (chainOf[p] >= 0 && chainAlive[chainOf[p]]) area[p] = mark;
+    for (int r = 0; r < regions; ++r) {
+        if (!regionAlive[r] || borderBegin[r] == borderBegin[r + 1]) continue;
+        bool small = true;
+        for (int i = regionBegin[r]; i < regionBegin[r + 1] && small; ++i) {
+            int cx = points[i] / n, cy = points[i] % n;
+            if (at(cx, cy) != EMPTY) continue;
+            bool touches = false;
+            for (int k = 0; k < 4 && !touches; ++k)
+                touches = at(cx + dx[k], cy + dy[k]) == color;
+            small = touches;
+        }
+        if (small)
+            for (int i = regionBegin[r]; i < regionBegin[r + 1]; ++i) area[points[i]] = mark;
+    }
+}
+
 // --- 围棋规则 ---
-class GoRule : public GameRule {
+class GoRule final : public GameRule {
 private:
-    bool visited[19][19];
+    // 每个交叉点周围 3x3 (不含自身) 的 16 位图案码：8 个邻点各 2 bit (0 空 / 1 黑 / 2 白 / 3 盘外)，
+    // 邻点次序为 (-1,-1) (-1,0) (-1,1) (0,-1) (0,1) (1,-1) (1,0) (1,1)。
+    // 规则内所有落子/提子都经由 place，随之更新 8 个邻点的图案码
+    vector<uint16_t> patternCodes;
+    // 最近一次数子的归属及当时的棋盘键 (供 finalOwnership 复用)
+    vector<int8_t> scoredOwner;
+    uint64_t scoredHash = 0;
+
+    static int neighbourSlot(int dx, int dy) {
+        int k = (dx + 1) * 3 + (dy + 1);
+        return k > 4 ? k - 1 : k;
+    }
+
+    void rebuildPatterns() {
+        int n = board->getSize();
+        patternCodes.assign((size_t)n * n, 0);
+        for (int x = 0; x < n; ++x)
+            for (int y = 0; y < n; ++y) {
+                uint16_t code = 0;
+                for (int dx = -1; dx <= 1; ++dx)
+                    for (int dy = -1; dy <= 1; ++dy) {
+                        if (dx == 0 && dy == 0) continue;
+                        int v = board->isValidBounds(x + dx, y + dy) ? board->getPiece(x + dx, y + dy) : 3;
+                        code |= (uint16_t)(v << (2 * neighbourSlot(dx, dy)));
+                    }
+                patternCodes[x * n + y] = code;
+            }
+    }
+
+    void place(int x, int y, PieceType p) {
+        board->setPiece(x, y, p);
+        int n = board->getSize();
+        for (int dx = -1; dx <= 1; ++dx)
+            for (int dy = -1; dy <= 1; ++dy) {
+                int nx = x + dx, ny = y + dy;
+                if ((dx == 0 && dy == 0) || !board->isValidBounds(nx, ny)) continue;
+                // 从邻点看，(x, y) 位于 (-dx, -dy) 方向
+                int shift = 2 * neighbourSlot(-dx, -dy);
+                uint16_t& code = patternCodes[nx * n + ny];
+                code = (uint16_t)((code & ~(3u << shift)) | ((unsigned)p << shift));
+            }
+    }
+
+    // 访问标记按代计数：每次数气只需递增 visitMark，不必清空整张表
+    unsigned visited[19][19] = {};
+    unsigned visitMark = 0;
     int countLibertiesDFS(int x, int y, PieceType color, vector<Point>& group) {
         if (!board->isValidBounds(x, y)) return 0;
-        if (visited[x][y]) return 0;
-        visited[x][y] = true;
+        if (visited[x][y] == visitMark) return 0;
+        visited[x][y] = visitMark;
         PieceType p = board->getPiece(x, y);
         if (p == EMPTY) return 1;
         if (p != color) return 0;
@@ -279,8 +618,10 @@ private:
         return liberties;
     }
     int getLiberties(int x, int y, PieceType color, vector<Point>& group) {
-        int s = board->getSize();
-        for(int i=0; i<s; ++i) for(int j=0; j<s; ++j) visited[i][j] = false;
+        if (++visitMark == 0) { // 计数回绕时才真正清表
+            for (auto& row : visited) fill(begin(row), end(row), 0u);
+            visitMark = 1;
+        }
         return countLibertiesDFS(x, y, color, group);
     }
     void removeDeadStones(int x, int y, PieceType opponent) {
@@ -290,22 +631,41 @@ private:
             if (board->isValidBounds(nx, ny) && board->getPiece(nx, ny) == opponent) {
                 vector<Point> group;
                 if (getLiberties(nx, ny, opponent, group) == 0) {
-                    for (auto& p : group) board->setPiece(p.x, p.y, EMPTY);
+                    for (auto& p : group) place(p.x, p.y, EMPTY);
                 }
             }
         }
     }
+    void bensonForColor(PieceType color, int8_t mark, vector<int8_t>& area) const {
+        const Board& b = *board;
+        bensonPassAlive(b.getSize(), [&b](int x, int y) {
+            return b.isValidBounds(x, y) ? (int)b.getPiece(x, y) : 3;
+        }, color, mark, area);
+    }
+
+    // 模拟中已无条件确定归属的点 (黑 +1 / 白 -1)，随机模拟不再在这些点上落子
+    vector<int8_t> settledArea;
+
+protected:
+    // 棋盘被整体改写后图案码随之重建
+    GameStatus recomputeStatus() override {
+        rebuildPatterns();
+        return GameRule::recomputeStatus();
+    }
+
 public:
-    GoRule(Board* b) : GameRule(b) {}
+    GoRule(Board* b) : GameRule(b) { rebuildPatterns(); }
     
     GameRule* clone(Board* newBoard) const override {
-        return new GoRule(newBoard);
+        GoRule* r = new GoRule(*this);
+        r->board = newBoard;
+        return r;
     }
 
     bool supportsPass() const override { return true; }
     bool isValidMove(int x, int y, PieceType player) override {
         if (!board->isValidBounds(x, y) || board->getPiece(x, y) != EMPTY) return false;
-        board->setPiece(x, y, player); // 试下
+        place(x, y, player); // 试下
         bool captures = false;
         PieceType opponent = getOpponent(player);
         int dx[] = {0, 0, 1, -1}; int dy[] = {1, -1, 0, 0};
@@ -321,72 +681,116 @@ public:
             vector<Point> selfGroup;
             if (getLiberties(x, y, player, selfGroup) == 0) suicide = true;
         }
-        board->setPiece(x, y, EMPTY); // 撤销
+        place(x, y, EMPTY); // 撤销
         return !suicide;
     }
     void makeMove(int x, int y, PieceType player) override {
-        if (x == -1 && y == -1) return;
-        board->setPiece(x, y, player);
+        if (x == -1 && y == -1) { registerPass(); return; }
+        place(x, y, player);
         removeDeadStones(x, y, getOpponent(player));
+        consecutivePasses = 0;
     }
-    GameStatus checkWin(int x, int y) override { return PLAYING; } 
     
-    void calculateScore(float& blackScore, float& whiteScore) override {
+    // 贴目 (白方)
+    static constexpr float KOMI = 3.75f;
+
+    // 无条件活 (pass-alive) 的区域：area[x * N + y] 为 +1 黑 / -1 白 / 0 未定
+    void passAliveArea(vector<int8_t>& area) const {
+        area.assign((size_t)board->getSize() * board->getSize(), 0);
+        bensonForColor(BLACK, 1, area);
+        bensonForColor(WHITE, -1, area);
+    }
+    uint16_t patternCode(int x, int y) const { return patternCodes[x * board->getSize() + y]; }
+    // 黑白互换后的图案码 (盘外 3 保持不变)，用于把图案统一到"行棋方为黑"的视角
+    static uint16_t swapColours(uint16_t code) {
+        return (uint16_t)(((code & 0x5555) << 1) | ((code & 0xAAAA) >> 1));
+    }
+
+    // 随机模拟用：重新计算已确定的区域
+    void refreshSettledArea() { passAliveArea(settledArea); }
+    bool isSettled(int x, int y) const {
+        return !settledArea.empty() && settledArea[x * board->getSize() + y] != 0;
+    }
+
+    // 数子法的逐点归属：无条件活的区域直接归属 (其中的对方棋子按死子计)；
+    // 其余棋子归其颜色，只与一种颜色相邻的空白区域归该色，其余为 0
+    // owner[x * N + y]: +1 黑 / -1 白 / 0 中立
+    void areaOwnership(vector<int8_t>& owner) const {
         int size = board->getSize();
-        blackScore = 0;
-        whiteScore = 0;
-        vector<vector<bool>> checked(size, vector<bool>(size, false));
+        vector<int8_t> settled;
+        passAliveArea(settled);
+        owner.assign((size_t)size * size, 0);
+        vector<bool> checked((size_t)size * size, false);
+        vector<Point> territory;
         int dx[] = {0, 0, 1, -1};
         int dy[] = {1, -1, 0, 0};
 
         for(int i=0; i<size; ++i) {
             for(int j=0; j<size; ++j) {
-                if(checked[i][j]) continue;
+                if(checked[i * size + j]) continue;
+                checked[i * size + j] = true;
 
                 PieceType p = board->getPiece(i, j);
-                if(p == BLACK) {
-                    blackScore += 1.0;
-                    checked[i][j] = true;
-                } else if(p == WHITE) {
-                    whiteScore += 1.0;
-                    checked[i][j] = true;
-                } else {
-                    vector<Point> territory;
-                    queue<Point> q;
-                    q.push({i, j});
-                    checked[i][j] = true;
-                    territory.push_back({i, j});
-                    bool touchesBlack = false; bool touchesWhite = false;
-
-                    while(!q.empty()) {
-                        Point cur = q.front(); q.pop();
-                        for(int k=0; k<4; ++k) {
-                            int nx = cur.x + dx[k]; int ny = cur.y + dy[k];
-                            if(board->isValidBounds(nx, ny)) {
-                                PieceType neighbor = board->getPiece(nx, ny);
-                                if(neighbor == EMPTY) {
-                                    if(!checked[nx][ny]) {
-                                        checked[nx][ny] = true;
-                                        q.push({nx, ny});
-                                        territory.push_back({nx, ny});
-                                    }
-                                } else if(neighbor == BLACK) touchesBlack = true;
-                                else if(neighbor == WHITE) touchesWhite = true;
+                if(p != EMPTY) {
+                    owner[i * size + j] = (p == BLACK) ? 1 : -1;
+                    continue;
+                }
+                territory.clear();
+                territory.push_back({i, j});
+                bool touchesBlack = false; bool touchesWhite = false;
+                for(size_t head = 0; head < territory.size(); ++head) {
+                    Point cur = territory[head];
+                    for(int k=0; k<4; ++k) {
+                        int nx = cur.x + dx[k]; int ny = cur.y + dy[k];
+                        if(!board->isValidBounds(nx, ny)) continue;
+                        PieceType neighbor = board->getPiece(nx, ny);
+                        if(neighbor == EMPTY) {
+                            if(!checked[nx * size + ny]) {
+                                checked[nx * size + ny] = true;
+                                territory.push_back({nx, ny});
                             }
-                        }
+                        } else if(neighbor == BLACK) touchesBlack = true;
+                        else touchesWhite = true;
                     }
-                    if(touchesBlack && !touchesWhite) blackScore += territory.size();
-                    else if(!touchesBlack && touchesWhite) whiteScore += territory.size();
                 }
+                int8_t o = (touchesBlack && !touchesWhite) ? 1 : ((touchesWhite && !touchesBlack) ? -1 : 0);
+                if (o != 0)
+                    for(auto& t : territory) owner[t.x * size + t.y] = o;
             }
         }
-        whiteScore += 3.75; 
+        for (size_t p = 0; p < owner.size(); ++p)
+            if (settled[p] != 0) owner[p] = settled[p];
+    }
+    
+    // 终局局面的归属：双方连续虚着时 scoreStatus 已经数过子，棋盘未变就直接取用那次的结果
+    void finalOwnership(vector<int8_t>& owner) const {
+        if (!scoredOwner.empty() && scoredHash == board->getHash()) owner = scoredOwner;
+        else areaOwnership(owner);
+    }
+
+    void calculateScore(float& blackScore, float& whiteScore) override {
+        areaOwnership(scoredOwner);
+        scoredHash = board->getHash();
+        blackScore = 0;
+        whiteScore = 0;
+        for (int8_t o : scoredOwner) {
+            if (o > 0) blackScore += 1.0;
+            else if (o < 0) whiteScore += 1.0;
+        }
+        whiteScore += KOMI; 
     }
 };
 
 // --- 黑白棋 (Reversi) 规则 ---
-class ReversiRule : public GameRule {
+class ReversiRule final : public GameRule {
 private:
+    // 棋盘下满或一方被吃光；双方均无子可下由连续两次虚着判定
+    bool isOver() const {
+        return board->countPieces(EMPTY) == 0 ||
+               board->countPieces(BLACK) == 0 ||
+               board->countPieces(WHITE) == 0;
+    }
+
     bool checkDirection(int x, int y, int dx, int dy, PieceType player, bool flip) {
         PieceType opponent = getOpponent(player);
         int i = 1;
@@ -410,11 +814,18 @@ private:
         }
     }
 
+protected:
+    GameStatus recomputeStatus() override {
+        return (isOver() || consecutivePasses >= 2) ? scoreStatus() : PLAYING;
+    }
+
 public:
     ReversiRule(Board* b) : GameRule(b) {}
     
     GameRule* clone(Board* newBoard) const override {
-        return new ReversiRule(newBoard);
+        ReversiRule* r = new ReversiRule(*this);
+        r->board = newBoard;
+        return r;
     }
 
     void initBoard() override {
@@ -438,27 +849,32 @@ public:
     }
 
     void makeMove(int x, int y, PieceType player) override {
-        if (x == -1 && y == -1) return;
+        if (x == -1 && y == -1) { registerPass(); return; }
         board->setPiece(x, y, player);
         int dx[] = {0, 0, 1, -1, 1, 1, -1, -1};
         int dy[] = {1, -1, 0, 0, 1, -1, 1, -1};
         for (int i = 0; i < 8; ++i) {
             checkDirection(x, y, dx[i], dy[i], player, true); 
         }
-    }
-
-    GameStatus checkWin(int x, int y) override {
-        if (board->countPieces(EMPTY) == 0) {
-            int b = board->countPieces(BLACK);
-            int w = board->countPieces(WHITE);
-            if (b > w) return BLACK_WIN;
-            if (w > b) return WHITE_WIN;
-            return DRAW;
-        }
-        return PLAYING;
+        consecutivePasses = 0;
+        if (isOver()) gameStatus = scoreStatus();
     }
 };
 
+
+// 各游戏的标准棋盘尺寸
+int boardSizeFor(GameType type) {
+    if (type == REVERSI) return 8;
+    if (type == GO) return 19;
+    return 15;
+}
+
+unique_ptr<GameRule> createRule(GameType type, Board* board) {
+    if (type == GOMOKU) return make_unique<GomokuRule>(board);
+    if (type == GO) return make_unique<GoRule>(board);
+    return make_unique<ReversiRule>(board);
+}
+
 // ==========================================
 // 4. View 层
 // ==========================================
@@ -531,6 +947,10 @@ public:
     string getName() const { return name; }
     PieceType getColor() const { return color; }
     bool isAI() const { return name.find("AI") != string::npos; }
+    // 上一手由搜索给出时，写出搜索对局面的估值 (行棋方胜率) 并返回 true；用于认输与和棋裁决
+    virtual bool lastValue(double&) const { return false; }
+    // 上一手由搜索给出且有逐点归属统计 (围棋) 时，写出归属与黑方领先目数的期望并返回 true
+    virtual bool lastOwnership(vector<float>&, double&) const { return false; }
 };
 
 class HumanPlayer : public Player {
@@ -555,573 +975,5372 @@ public:
     }
 };
 
-// --- MCTS 节点结构 ---
-struct MCTSNode {
-    MCTSNode* parent;
-    vector<MCTSNode*> children;
-    Point move; // 到达此节点的落子
-    PieceType playerMoved; // 谁落子到达了这里
-    int visits;
-    double wins; // 针对 playerMoved 的胜场价值累加
-    vector<Point> untriedMoves;
-
-    MCTSNode(MCTSNode* p, Point m, PieceType player, const Board& board, GameRule* rule) 
-        : parent(p), move(m), playerMoved(player), visits(0), wins(0.0) 
-    {
-        // 找出所有未尝试的移动
-        PieceType nextP = getOpponent(player);
-        for(int i=0; i<board.getSize(); ++i) {
-            for(int j=0; j<board.getSize(); ++j) {
-                if(rule->isValidMove(i, j, nextP)) {
-                    untriedMoves.push_back({i, j});
-                }
-            }
-        }
-    }
+// --- 策略/价值网络评估器 (int8 量化卷积网络) ---
+// 模型文件格式 (小端)：
+//   头部 32 字节: "PVN1" | version | inputPlanes | channels | layers | 3 x reserved
+//   每层: float outScale | float wScale[C] | float bias[C] | int8 weights[C][rowLen]
+//         rowLen = 9 * inC 向上对齐到 64，权重按 [输出通道][3x3 位置][输入通道] 排列
+//   输出头: float policyW[C] | passW[C] | valueW[C] | policyB | passB | valueB
+// 激活值量化到 [0,127] (ReLU 之后)，卷积用 int8 点积累加到 int32
+
+// 只读映射模型文件，权重直接指向映射区域，不做拷贝
+class MappedFile {
+private:
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    vector<uint8_t> buffer;
+#endif
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
 
-    ~MCTSNode() {
-        for(auto c : children) delete c;
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        ifstream file(path, ios::binary);
+        if (!file.is_open()) return false;
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        data = buffer.data();
+        length = buffer.size();
+        return length > 0;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) { ::close(fd); return false; }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        data = static_cast<const uint8_t*>(p);
+        length = st.st_size;
+        return true;
+#endif
     }
-    
-    // UCT 选择公式 (Upper Confidence Bound for Trees)
-    MCTSNode* bestChild(double cParam = 1.414) {
-        MCTSNode* best = nullptr;
-        double bestValue = -std::numeric_limits<double>::infinity();
-        for(auto child : children) {
-            double uct = (child->wins / (double)child->visits) + 
-                         cParam * sqrt(log(visits) / (double)child->visits);
-            if(uct > bestValue) {
-                bestValue = uct;
-                best = child;
-            }
-        }
-        return best;
+
+    void close() {
+#ifndef _WIN32
+        if (data) munmap(const_cast<uint8_t*>(data), length);
+#else
+        buffer.clear();
+#endif
+        data = nullptr;
+        length = 0;
     }
+
+    const uint8_t* bytes() const { return data; }
+    size_t size() const { return length; }
 };
 
-class AIPlayer : public Player {
-private:
-    int level; 
+// int8 点积：a 为非负激活 [0,127]，b 为有符号权重，n 须为 64 的倍数
+// 127 * 127 * 2 < 32767，maddubs 的 16 位中间结果不会饱和
+static int32_t dotInt8Scalar(const int8_t* a, const int8_t* b, int n) {
+    int32_t sum = 0;
+    for (int i = 0; i < n; ++i) sum += (int32_t)a[i] * b[i];
+    return sum;
+}
+
+#ifdef HW2_X86_SIMD
+__attribute__((target("avx2")))
+static int32_t dotInt8AVX2(const int8_t* a, const int8_t* b, int n) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(va, vb), ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_hadd_epi32(s, s);
+    s = _mm_hadd_epi32(s, s);
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static int32_t dotInt8AVX512(const int8_t* a, const int8_t* b, int n) {
+    const __m512i ones = _mm512_set1_epi16(1);
+    __m512i acc = _mm512_setzero_si512();
+    for (int i = 0; i < n; i += 64) {
+        __m512i va = _mm512_loadu_si512((const void*)(a + i));
+        __m512i vb = _mm512_loadu_si512((const void*)(b + i));
+        acc = _mm512_add_epi32(acc, _mm512_madd_epi16(_mm512_maddubs_epi16(va, vb), ones));
+    }
+    int32_t lanes[16];
+    _mm512_storeu_si512((void*)lanes, acc);
+    int32_t sum = 0;
+    for (int i = 0; i < 16; ++i) sum += lanes[i];
+    return sum;
+}
+#endif
+
+typedef int32_t (*DotInt8Fn)(const int8_t*, const int8_t*, int);
+
+// 运行时按 CPU 能力选择内核，无需额外编译参数
+static DotInt8Fn selectDotInt8() {
+#ifdef HW2_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) return dotInt8AVX512;
+    if (__builtin_cpu_supports("avx2")) return dotInt8AVX2;
+#endif
+    return dotInt8Scalar;
+}
+static const DotInt8Fn dotInt8 = selectDotInt8();
+
+class PolicyValueNet {
 public:
-    AIPlayer(string n, PieceType c, int lvl) : Player(n, c), level(lvl) {}
-    
-    // Level 3: MCTS AI 实现
-    Point getMCTSMove(const Board& realBoard, GameRule* realRule) {
-        // 1. 复制当前局面，避免破坏真实棋盘
-        Board rootBoard(realBoard);
-        unique_ptr<GameRule> rootRule(realRule->clone(&rootBoard));
-        
-        // 根节点：上一手是对手下的，现在轮到我 (color) 下
-        MCTSNode* root = new MCTSNode(nullptr, {-1,-1}, getOpponent(color), rootBoard, rootRule.get());
-        
-        // 设定思考时间限制 (例如 2 秒)
-        auto startTime = std::chrono::high_resolution_clock::now();
-        int iterations = 0;
-        
-        while(true) {
-            auto now = std::chrono::high_resolution_clock::now();
-            if(std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count() > 2000) break;
-            
-            iterations++;
-            
-            // --- 1. Selection (选择) ---
-            MCTSNode* node = root;
-            Board simBoard(rootBoard);
-            unique_ptr<GameRule> simRule(rootRule->clone(&simBoard));
-            PieceType simPlayer = color; // 从当前 AI 开始模拟
-            
-            // 只要节点完全扩展且有子节点，就根据 UCT 向下深入
-            while(node->untriedMoves.empty() && !node->children.empty()) {
-                node = node->bestChild();
-                if(node->move.x != -1) {
-                    simRule->makeMove(node->move.x, node->move.y, simPlayer);
+    static const int INPUT_PLANES = 4; // 己方 / 对方 / 空点 / 盘内
+    static const int ROW_ALIGN = 64;
+    static const uint32_t VERSION = 1;
+
+private:
+    struct ConvLayer {
+        int inC;
+        int rowLen;
+        const int8_t* weights;  // [C][rowLen]
+        vector<float> mult;     // inScale * wScale[oc] / outScale
+        vector<float> offset;   // bias[oc] / outScale
+    };
+
+    MappedFile file;
+    int channels = 0;
+    vector<ConvLayer> layers;
+    float lastScale = 0;        // 最后一层激活的量化步长
+    const float* policyW = nullptr;
+    const float* passW = nullptr;
+    const float* valueW = nullptr;
+    float policyB = 0, passB = 0, valueB = 0;
+
+    void conv(const ConvLayer& L, const int8_t* in, int n, int8_t* out) const {
+        thread_local vector<int8_t> patch;
+        patch.assign(L.rowLen, 0);
+        for (int x = 0; x < n; ++x) {
+            for (int y = 0; y < n; ++y) {
+                // 3x3 邻域展开成一行 (im2col)，盘外补零
+                int t = 0;
+                for (int dx = -1; dx <= 1; ++dx) {
+                    for (int dy = -1; dy <= 1; ++dy, ++t) {
+                        int8_t* dst = patch.data() + t * L.inC;
+                        int nx = x + dx, ny = y + dy;
+                        if (nx < 0 || nx >= n || ny < 0 || ny >= n) memset(dst, 0, L.inC);
+                        else memcpy(dst, in + (nx * n + ny) * L.inC, L.inC);
+                    }
                 }
-                simPlayer = getOpponent(simPlayer);
-            }
-            
-            // --- 2. Expansion (扩展) ---
-            if(!node->untriedMoves.empty()) {
-                int idx = rand() % node->untriedMoves.size();
-                Point move = node->untriedMoves[idx];
-                node->untriedMoves.erase(node->untriedMoves.begin() + idx);
-                
-                simRule->makeMove(move.x, move.y, simPlayer);
-                MCTSNode* child = new MCTSNode(node, move, simPlayer, simBoard, simRule.get());
-                node->children.push_back(child);
-                node = child;
-                simPlayer = getOpponent(simPlayer);
-            }
-            
-            // --- 3. Simulation (模拟/Rollout) ---
-            int depth = 0;
-            while(depth < 60) { // 限制模拟深度，防止性能耗尽
-                // 简单判断终局 (通用检查: 双方均无子可下)
-                if (!simRule->hasValidMove(BLACK) && !simRule->hasValidMove(WHITE)) break;
-                // 五子棋/黑白棋特定终局检查
-                if (simRule->checkWin(0, 0) != PLAYING) break;
-
-                // 寻找可行步
-                vector<Point> moves;
-                for(int i=0; i<simBoard.getSize(); ++i) 
-                    for(int j=0; j<simBoard.getSize(); ++j) 
-                        if(simRule->isValidMove(i, j, simPlayer)) moves.push_back({i, j});
-                
-                if(moves.empty()) {
-                    simPlayer = getOpponent(simPlayer); // 虚着 Pass
-                    continue;
+                int8_t* o = out + (x * n + y) * channels;
+                for (int oc = 0; oc < channels; ++oc) {
+                    int32_t acc = dotInt8(patch.data(), L.weights + (size_t)oc * L.rowLen, L.rowLen);
+                    float q = acc * L.mult[oc] + L.offset[oc];
+                    o[oc] = (int8_t)(q <= 0 ? 0 : (q >= 127 ? 127 : lrintf(q)));
                 }
-                
-                // 随机落子
-                Point randomMove = moves[rand() % moves.size()];
-                simRule->makeMove(randomMove.x, randomMove.y, simPlayer);
-                simPlayer = getOpponent(simPlayer);
-                depth++;
-            }
-            
-            // --- 4. Backpropagation (反向传播) ---
-            double result = 0.0;
-            GameStatus status = simRule->checkWin(0,0);
-            
-            // 如果没分出胜负(深度耗尽或无子可下)，强制计算分数
-            if(status == PLAYING || status == DRAW) {
-               float bScore, wScore;
-               simRule->calculateScore(bScore, wScore);
-               if(bScore > wScore) status = BLACK_WIN;
-               else if(wScore > bScore) status = WHITE_WIN;
-               else status = DRAW;
             }
+        }
+    }
+
+public:
+    static int rowLength(int inC) {
+        return (9 * inC + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+    }
 
-            // 设定结果值：1.0 为黑胜，0.0 为白胜
-            if(status == BLACK_WIN) result = 1.0; 
-            else if(status == WHITE_WIN) result = 0.0;
-            else result = 0.5;
+    bool load(const string& path) {
+        layers.clear();
+        channels = 0;
+        if (!file.open(path)) return false;
+        const uint8_t* p = file.bytes();
+        const uint8_t* end = p + file.size();
+        uint32_t header[8];
+        if (file.size() < sizeof(header)) return false;
+        memcpy(header, p, sizeof(header));
+        if (memcmp(p, "PVN1", 4) != 0 || header[1] != VERSION || header[2] != INPUT_PLANES) return false;
+        channels = header[3];
+        int numLayers = header[4];
+        if (channels <= 0 || numLayers <= 0) { channels = 0; return false; }
+        p += sizeof(header);
 
-            while(node != nullptr) {
-                node->visits++;
-                // MCTS 的关键：站在节点代表的棋手视角看胜负
-                // 如果 node->playerMoved 是 BLACK，它希望结果是 1.0
-                if(node->playerMoved == BLACK) node->wins += result;
-                else node->wins += (1.0 - result); // 如果是 WHITE，它希望结果是 0.0
-                node = node->parent;
-            }
-        }
-        
-        // 最终决策：选择访问次数最多的子节点 (最稳健)
-        Point bestMove = {-1, -1};
-        int maxVisits = -1;
-        for(auto child : root->children) {
-            if(child->visits > maxVisits) {
-                maxVisits = child->visits;
-                bestMove = child->move;
+        float inScale = 1.0f / 127;
+        for (int l = 0; l < numLayers; ++l) {
+            ConvLayer L;
+            L.inC = (l == 0) ? INPUT_PLANES : channels;
+            L.rowLen = rowLength(L.inC);
+            size_t bytes = sizeof(float) * (1 + 2 * channels) + (size_t)channels * L.rowLen;
+            if (p + bytes > end) { layers.clear(); channels = 0; return false; }
+            const float* f = reinterpret_cast<const float*>(p);
+            float outScale = f[0];
+            L.mult.resize(channels);
+            L.offset.resize(channels);
+            for (int oc = 0; oc < channels; ++oc) {
+                L.mult[oc] = inScale * f[1 + oc] / outScale;
+                L.offset[oc] = f[1 + channels + oc] / outScale;
             }
+            L.weights = reinterpret_cast<const int8_t*>(p + sizeof(float) * (1 + 2 * channels));
+            layers.push_back(std::move(L));
+            inScale = outScale;
+            p += bytes;
         }
-        
-        cout << "MCTS 模拟次数: " << iterations << endl;
-        delete root; // 清理内存
-        return bestMove;
+        lastScale = inScale;
+        if (p + sizeof(float) * (3 * channels + 3) > end) { layers.clear(); channels = 0; return false; }
+        const float* h = reinterpret_cast<const float*>(p);
+        policyW = h;
+        passW = h + channels;
+        valueW = h + 2 * channels;
+        policyB = h[3 * channels];
+        passB = h[3 * channels + 1];
+        valueB = h[3 * channels + 2];
+        return true;
     }
 
-    Point getMove(const Board& board, GameRule* rule, GameView* view) override {
-        // Lv3 MCTS 调用
-        if (level == 3) {
-             cout << "AI (MCTS Lv3) 正在思考..." << endl;
-             Point m = getMCTSMove(board, rule);
-             if (m.x == -1) return {-1, -1}; // 无棋可走 Pass
-             return m;
-        }
+    bool isLoaded() const { return channels > 0; }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(800));
-        
-        vector<Point> validMoves;
-        for(int i=0; i<board.getSize(); ++i) {
-            for(int j=0; j<board.getSize(); ++j) {
-                if(rule->isValidMove(i, j, color)) validMoves.push_back({i, j});
+    // 一次查询：moves 中每个着法 ((-1,-1) 为虚着) 输出 softmax 先验，value 为 player 的胜率
+    struct Query {
+        const Board* board;
+        PieceType player;           // 轮到下的一方
+        const vector<Point>* moves;
+        vector<float>* priors;
+        float value;
+    };
+
+    // 批量评估：逐层处理整批局面，每层权重只从内存读入一次并在缓存中复用
+    void evaluateBatch(Query* queries, int count) const {
+        if (count <= 0) return;
+        int n = queries[0].board->getSize(), area = n * n;
+        size_t stride = (size_t)area * max(channels, (int)INPUT_PLANES);
+        thread_local vector<int8_t> actA, actB;
+        actA.assign(stride * count, 0);
+        actB.assign(stride * count, 0);
+        for (int q = 0; q < count; ++q) {
+            const Board& board = *queries[q].board;
+            PieceType player = queries[q].player, opponent = getOpponent(player);
+            for (int x = 0; x < n; ++x) {
+                for (int y = 0; y < n; ++y) {
+                    int8_t* a = actA.data() + q * stride + (x * n + y) * INPUT_PLANES;
+                    PieceType p = board.getPiece(x, y);
+                    a[0] = (p == player) ? 127 : 0;
+                    a[1] = (p == opponent) ? 127 : 0;
+                    a[2] = (p == EMPTY) ? 127 : 0;
+                    a[3] = 127;
+                }
             }
         }
+        for (auto& L : layers) {
+            for (int q = 0; q < count; ++q) conv(L, actA.data() + q * stride, n, actB.data() + q * stride);
+            actA.swap(actB);
+        }
 
-        if (validMoves.empty()) return {-1, -1}; 
-
-        if (level == 1) { // Lv1 Random
-            int idx = rand() % validMoves.size();
-            return validMoves[idx];
-        } else { // Lv2 Greedy
-            int bestScore = -99999;
-            Point bestMove = validMoves[0];
-            
-            // 黑白棋位置权值表 (贪心核心)
-            int weights[8][8] = {
-                {100, -20, 10,  5,  5, 10, -20, 100},
-                {-20, -50, -2, -2, -2, -2, -50, -20},
-                { 10,  -2, -1, -1, -1, -1,  -2,  10},
-                {  5,  -2, -1, -1, -1, -1,  -2,   5},
-                {  5,  -2, -1, -1, -1, -1,  -2,   5},
-                { 10,  -2, -1, -1, -1, -1,  -2,  10},
-                {-20, -50, -2, -2, -2, -2, -50, -20},
-                {100, -20, 10,  5,  5, 10, -20, 100}
-            };
+        // 输出头在浮点下计算 (每点仅 C 次乘加)
+        thread_local vector<float> pooled;
+        for (int q = 0; q < count; ++q) {
+            const int8_t* act = actA.data() + q * stride;
+            pooled.assign(channels, 0.0f);
+            for (int i = 0; i < area; ++i) {
+                const int8_t* a = act + (size_t)i * channels;
+                for (int c = 0; c < channels; ++c) pooled[c] += a[c];
+            }
+            for (int c = 0; c < channels; ++c) pooled[c] *= lastScale / area;
 
-            for (auto p : validMoves) {
-                int score = 0;
-                if (p.x < 8 && p.y < 8) score += weights[p.x][p.y];
-                else score += 1; 
-                score += rand() % 5; 
-                if (score > bestScore) {
-                    bestScore = score;
-                    bestMove = p;
+            const vector<Point>& moves = *queries[q].moves;
+            vector<float>& priors = *queries[q].priors;
+            priors.assign(moves.size(), 0.0f);
+            float maxLogit = -std::numeric_limits<float>::infinity();
+            for (size_t k = 0; k < moves.size(); ++k) {
+                float logit;
+                if (moves[k].x < 0) {
+                    logit = passB;
+                    for (int c = 0; c < channels; ++c) logit += passW[c] * pooled[c];
+                } else {
+                    const int8_t* a = act + (size_t)(moves[k].x * n + moves[k].y) * channels;
+                    float sum = 0;
+                    for (int c = 0; c < channels; ++c) sum += policyW[c] * a[c];
+                    logit = policyB + sum * lastScale;
                 }
+                priors[k] = logit;
+                maxLogit = max(maxLogit, logit);
             }
-            return bestMove;
+            float total = 0;
+            for (auto& pr : priors) { pr = expf(pr - maxLogit); total += pr; }
+            for (auto& pr : priors) pr /= total;
+
+            float v = valueB;
+            for (int c = 0; c < channels; ++c) v += valueW[c] * pooled[c];
+            queries[q].value = 0.5f * (tanhf(v) + 1.0f);
         }
     }
-};
 
-// ==========================================
-// 6. Controller 层：游戏管理器
-// ==========================================
+    // 评估单个局面：返回 player (轮到下的一方) 的胜率 [0,1]
+    float evaluate(const Board& board, PieceType player, const vector<Point>& moves, vector<float>& priors) const {
+        Query q = {&board, player, &moves, &priors, 0.0f};
+        evaluateBatch(&q, 1);
+        return q.value;
+    }
+};
 
-struct GameState {
-    Board board;
-    PieceType currentPlayer;
-    int passCount;
-    vector<Point> moveHistory;
+// --- 批量叶节点评估队列 ---
+// 搜索线程提交叶节点后立即返回 future，评估线程凑满 batchSize 个或等待 maxWaitUs 后整批计算
+struct EvalResult {
+    float value;            // 轮到下的一方的胜率
+    vector<float> priors;
 };
 
-class GameManager {
+class BatchEvaluator {
 private:
-    unique_ptr<Board> board;
-    unique_ptr<GameRule> rule;
-    unique_ptr<GameView> view;
-    unique_ptr<UserManager> userMgr;
-    
-    unique_ptr<Player> playerBlack;
-    unique_ptr<Player> playerWhite;
-    
-    PieceType currentTurn;
-    GameType gameType;
-    int passCount;
-    
-    stack<GameState> undoStack;
-    vector<Point> moveHistory;
+    struct Request {
+        Board board;
+        PieceType player;
+        vector<Point> moves;
+        promise<EvalResult> result;
+        Request(const Board& b, PieceType p, const vector<Point>& m) : board(b), player(p), moves(m) {}
+    };
 
-    void saveState() {
-        GameState state = {*board, currentTurn, passCount, moveHistory};
-        undoStack.push(state);
+    const PolicyValueNet* net;
+    int batchSize;
+    int maxWaitUs;
+    mutex mtx;
+    condition_variable cv;
+    deque<unique_ptr<Request>> queue;
+    bool stopping = false;
+    thread worker;
+
+    void run() {
+        vector<unique_ptr<Request>> batch;
+        vector<PolicyValueNet::Query> queries;
+        vector<EvalResult> results;
+        while (true) {
+            {
+                unique_lock<mutex> lock(mtx);
+                cv.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty()) return; // stopping
+                auto deadline = chrono::steady_clock::now() + chrono::microseconds(maxWaitUs);
+                cv.wait_until(lock, deadline, [&] { return stopping || (int)queue.size() >= batchSize; });
+                while (!queue.empty() && (int)batch.size() < batchSize) {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+            results.resize(batch.size());
+            queries.resize(batch.size());
+            for (size_t i = 0; i < batch.size(); ++i)
+                queries[i] = {&batch[i]->board, batch[i]->player, &batch[i]->moves, &results[i].priors, 0.0f};
+            net->evaluateBatch(queries.data(), (int)queries.size());
+            for (size_t i = 0; i < batch.size(); ++i) {
+                results[i].value = queries[i].value;
+                batch[i]->result.set_value(std::move(results[i]));
+            }
+            batch.clear();
+        }
     }
 
-    // 辅助函数：根据 AI 等级返回名字
-    string getAIName(int level) {
-        if (level == 1) return "AI-Simple";
-        if (level == 2) return "AI-Greedy";
-        if (level == 3) return "AI-MCTS";
-        return "AI";
+public:
+    BatchEvaluator(const PolicyValueNet* n, int size, int waitUs)
+        : net(n), batchSize(max(1, size)), maxWaitUs(waitUs) {
+        worker = thread(&BatchEvaluator::run, this);
+    }
+    BatchEvaluator(const BatchEvaluator&) = delete;
+    BatchEvaluator& operator=(const BatchEvaluator&) = delete;
+    ~BatchEvaluator() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        worker.join();
     }
 
-    void setupPlayers(int mode, string username) {
-        if (mode == 1) { // PvP: 人人对战
-            playerBlack = make_unique<HumanPlayer>(username, BLACK);
-            playerWhite = make_unique<HumanPlayer>("Player2", WHITE);
-        } 
-        else if (mode == 2) { // PvAI: 人机对战
-            int level = 1;
-            string input = view->getUserInput("选择AI难度 (1:简单, 2:贪心, 3:MCTS): ");
-            if (input == "2") level = 2;
-            if (input == "3") level = 3;
-            
-            string side = view->getUserInput("你执黑吗? (y/n): ");
-            if (side == "y") {
-                playerBlack = make_unique<HumanPlayer>(username, BLACK);
-                playerWhite = make_unique<AIPlayer>(getAIName(level) + "(W)", WHITE, level);
+    future<EvalResult> submit(const Board& board, PieceType player, const vector<Point>& moves) {
+        unique_ptr<Request> req = make_unique<Request>(board, player, moves);
+        future<EvalResult> f = req->result.get_future();
+        {
+            lock_guard<mutex> lock(mtx);
+            queue.push_back(std::move(req));
+        }
+        cv.notify_one();
+        return f;
+    }
+};
+
+string modelFileName(GameType type) {
+    if (type == GOMOKU) return "model_gomoku.pvn";
+    if (type == GO) return "model_go.pvn";
+    return "model_reversi.pvn";
+}
+
+// 每种棋一个模型文件，首次使用时映射；文件不存在返回 nullptr (退回随机模拟)
+const PolicyValueNet* loadNetForGame(GameType type) {
+    static mutex mtx;
+    static map<GameType, unique_ptr<PolicyValueNet>> cache;
+    lock_guard<mutex> lock(mtx);
+    auto it = cache.find(type);
+    if (it == cache.end()) {
+        unique_ptr<PolicyValueNet> net = make_unique<PolicyValueNet>();
+        if (!net->load(modelFileName(type))) net.reset();
+        it = cache.emplace(type, std::move(net)).first;
+    }
+    return it->second.get();
+}
+
+// --- 搜索线程用的轻量随机数 (xorshift64*)，每线程一个，避免 rand() 的全局状态 ---
+class FastRandom {
+private:
+    uint64_t state;
+public:
+    explicit FastRandom(uint64_t seed) : state(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+    uint32_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint32_t)((state * 0x2545F4914F6CDD1DULL) >> 32);
+    }
+    // [0, n) 内均匀取整
+    int below(int n) { return (int)(((uint64_t)next() * (uint32_t)n) >> 32); }
+};
+
+// --- 围棋战术读取用的定长棋盘 ---
+// 带边界哨兵的定长数组：落子、提子都记入撤销栈，可整体回退到任一标记；
+// 同时增量维护与 Board 相同的 Zobrist 哈希。征子读取与死活求解共用，读取过程不分配内存
+class TacticalBoard {
+public:
+    static const int W = Board::MAX_SIZE + 2;
+
+protected:
+    static const int CELLS = W * W;
+    static const int UNDO_CAP = CELLS * 4;
+    static constexpr int8_t OFFBOARD = 3;
+    static constexpr int DIR[4] = {1, -1, W, -W};
+
+    struct Undo { int16_t pos; int8_t before; };
+
+    int n = 0;
+    int8_t cell[CELLS];
+    uint64_t hash = 0;
+    Undo undo[UNDO_CAP];
+    int undoTop = 0;
+    uint32_t mark[CELLS] = {};
+    uint32_t markStamp = 0;
+    int16_t stack[CELLS];
+
+    static int toPos(int x, int y) { return (x + 1) * W + (y + 1); }
+    static Point toPoint(int pos) { return {pos / W - 1, pos % W - 1}; }
+
+    // 与 Board::zobrist 一致的逐格键 (空点与盘外为 0)
+    static uint64_t zobristAt(int pos, int v) {
+        static const vector<uint64_t> table = [] {
+            vector<uint64_t> t((size_t)CELLS * 4, 0);
+            for (int x = 0; x < Board::MAX_SIZE; ++x)
+                for (int y = 0; y < Board::MAX_SIZE; ++y) {
+                    t[toPos(x, y) * 4 + BLACK] = Board::zobrist(x, y, BLACK);
+                    t[toPos(x, y) * 4 + WHITE] = Board::zobrist(x, y, WHITE);
+                }
+            return t;
+        }();
+        return table[pos * 4 + v];
+    }
+
+    void loadCells(const Board& board) {
+        n = board.getSize();
+        fill(cell, cell + CELLS, OFFBOARD);
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j) cell[toPos(i, j)] = (int8_t)board.getPiece(i, j);
+        hash = board.getHash();
+        undoTop = 0;
+    }
+
+    void nextMark() {
+        if (++markStamp == 0) {
+            memset(mark, 0, sizeof(mark));
+            markStamp = 1;
+        }
+    }
+
+    // pos 所在棋串的气，数到超过 limit 口即停；前 min(2, limit) 口气写入 libs (可为空)
+    int countLibs(int pos, int limit, int* libs) {
+        nextMark();
+        int color = cell[pos], top = 0, count = 0;
+        stack[top++] = (int16_t)pos;
+        mark[pos] = markStamp;
+        while (top > 0) {
+            int p = stack[--top];
+            for (int d : DIR) {
+                int q = p + d;
+                if (mark[q] == markStamp) continue;
+                if (cell[q] == EMPTY) {
+                    mark[q] = markStamp;
+                    if (libs && count < 2 && count < limit) libs[count] = q;
+                    if (++count > limit) return count;
+                } else if (cell[q] == color) {
+                    mark[q] = markStamp;
+                    stack[top++] = (int16_t)q;
+                }
+            }
+        }
+        return count;
+    }
+
+    void set(int pos, int8_t v) {
+        undo[undoTop++] = {(int16_t)pos, cell[pos]};
+        hash ^= zobristAt(pos, cell[pos]) ^ zobristAt(pos, v);
+        cell[pos] = v;
+    }
+    void removeChain(int pos) {
+        int color = cell[pos], top = 0;
+        stack[top++] = (int16_t)pos;
+        set(pos, EMPTY);
+        while (top > 0) {
+            int p = stack[--top];
+            for (int d : DIR)
+                if (cell[p + d] == color) {
+                    set(p + d, EMPTY);
+                    stack[top++] = (int16_t)(p + d);
+                }
+        }
+    }
+    // 落子并提掉无气的对方棋串；撤销缓冲不足时返回 false (按读不清处理)
+    bool play(int pos, int color) {
+        if (undoTop + CELLS + 1 > UNDO_CAP) return false;
+        set(pos, (int8_t)color);
+        for (int d : DIR) {
+            int q = pos + d;
+            if (cell[q] == 3 - color && countLibs(q, 0, nullptr) == 0) removeChain(q);
+        }
+        return true;
+    }
+    void rollback(int to) {
+        while (undoTop > to) {
+            --undoTop;
+            int pos = undo[undoTop].pos;
+            hash ^= zobristAt(pos, cell[pos]) ^ zobristAt(pos, undo[undoTop].before);
+            cell[pos] = undo[undoTop].before;
+        }
+    }
+};
+
+// --- 围棋征子读取 ---
+// 专用的小型战术搜索：只展开征子里的两类着法 (攻方从两口气叫吃；守方长出，或提掉叫吃自己的子)，
+// 节点数有上限，读不清时按"能逃"处理；结果按 (局面哈希, 棋串, 查询种类) 存入直接映射缓存
+class LadderReader : private TacticalBoard {
+private:
+    static const int NODE_LIMIT = 2000;
+    static const int DEPTH_LIMIT = 200;
+    static const int CACHE_SIZE = 4096;
+
+    struct CacheEntry { uint64_t key; int16_t answer; };
+
+    uint64_t loadedHash = 0;
+    bool loaded = false;
+    // 载入时预先求出的棋串信息，根局面的气数查询为 O(1)
+    int16_t chainOf[CELLS];
+    int16_t chainLibs[CELLS];
+    int16_t chainLib[CELLS][2];
+    int16_t chainBuf[CELLS];
+    int nodes = 0;
+    CacheEntry cache[CACHE_SIZE] = {};
+
+    // 守方先走，target 棋串只剩一口气：返回 true 表示逃不掉
+    bool defenderLoses(int target, int depth) {
+        if (++nodes > NODE_LIMIT || depth > DEPTH_LIMIT) return false;
+        int defender = cell[target], attacker = 3 - defender;
+        int libs[2];
+        int nl = countLibs(target, 1, libs);
+        if (nl == 0) return true;
+        if (nl >= 2) return false;
+        int escape = libs[0];
+
+        // 紧贴着、只剩一口气的攻方棋串可以提掉解围
+        int stones = 0;
+        nextMark();
+        chainBuf[stones++] = (int16_t)target;
+        mark[target] = markStamp;
+        for (int i = 0; i < stones; ++i)
+            for (int d : DIR) {
+                int q = chainBuf[i] + d;
+                if (cell[q] == defender && mark[q] != markStamp) {
+                    mark[q] = markStamp;
+                    chainBuf[stones++] = (int16_t)q;
+                }
+            }
+        int captures[8], nc = 0;
+        for (int i = 0; i < stones && nc < 8; ++i)
+            for (int d : DIR) {
+                int q = chainBuf[i] + d, lib;
+                if (cell[q] != attacker || countLibs(q, 1, &lib) != 1) continue;
+                if (find(captures, captures + nc, lib) == captures + nc && nc < 8) captures[nc++] = lib;
+            }
+        for (int i = 0; i < nc; ++i) {
+            int m = undoTop;
+            if (!play(captures[i], defender)) return false;
+            bool lost = attackerWins(target, depth + 1, nullptr);
+            rollback(m);
+            if (!lost) return false;
+        }
+
+        // 长出
+        int m = undoTop;
+        if (!play(escape, defender)) return false;
+        int after = countLibs(target, 2, nullptr);
+        bool lost = after <= 1 ? true : (after >= 3 ? false : attackerWins(target, depth + 1, nullptr));
+        rollback(m);
+        return lost;
+    }
+
+    // 攻方先走，target 棋串两口气：依次试两处叫吃，能征死时返回 true 并写出叫吃点
+    bool attackerWins(int target, int depth, int* move) {
+        if (++nodes > NODE_LIMIT || depth > DEPTH_LIMIT) return false;
+        int attacker = 3 - cell[target];
+        int libs[2];
+        int nl = countLibs(target, 2, libs);
+        if (nl == 1) {
+            if (move) *move = libs[0];
+            return true;
+        }
+        if (nl != 2) return false;
+        for (int k = 0; k < 2; ++k) {
+            int m = undoTop;
+            if (!play(libs[k], attacker)) return false;
+            // 叫吃的子自己只剩一口气会被反提，不算征子
+            bool win = countLibs(libs[k], 1, nullptr) >= 2 && defenderLoses(target, depth + 1);
+            rollback(m);
+            if (win) {
+                if (move) *move = libs[k];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    CacheEntry& cacheSlot(uint64_t key) { return cache[key & (CACHE_SIZE - 1)]; }
+    uint64_t cacheKey(int chain, int kind) const {
+        return loadedHash ^ ((uint64_t)(chain + 1) * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t)kind << 62);
+    }
+
+public:
+    // 载入局面 (与上次相同则跳过)，并求出所有棋串的气
+    void load(const Board& board) {
+        if (loaded && board.getHash() == loadedHash && board.getSize() == n) return;
+        loadCells(board);
+        loadedHash = board.getHash();
+        loaded = true;
+        fill(chainOf, chainOf + CELLS, (int16_t)-1);
+        int chains = 0;
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j) {
+                int pos = toPos(i, j);
+                if (cell[pos] == EMPTY || chainOf[pos] >= 0) continue;
+                // 一次泛洪同时分配编号并数气
+                int color = cell[pos], stones = 0, libs = 0;
+                nextMark();
+                chainBuf[stones++] = (int16_t)pos;
+                chainOf[pos] = (int16_t)chains;
+                chainLib[chains][0] = chainLib[chains][1] = 0;
+                for (int k = 0; k < stones; ++k)
+                    for (int d : DIR) {
+                        int q = chainBuf[k] + d;
+                        if (cell[q] == color && chainOf[q] < 0) {
+                            chainOf[q] = (int16_t)chains;
+                            chainBuf[stones++] = (int16_t)q;
+                        } else if (cell[q] == EMPTY && mark[q] != markStamp) {
+                            mark[q] = markStamp;
+                            if (libs < 2) chainLib[chains][libs] = (int16_t)q;
+                            libs++;
+                        }
+                    }
+                chainLibs[chains] = (int16_t)libs;
+                chains++;
+            }
+    }
+
+    // (x, y) 处棋串编号 (空点为 -1)，同一局面下同一棋串编号相同
+    int chainAt(const Board& board, int x, int y) {
+        load(board);
+        return chainOf[toPos(x, y)];
+    }
+
+    // (x, y) 处棋串的气数，前两口气写入 libs (可为空)；空点返回 0
+    int liberties(const Board& board, int x, int y, Point* libs) {
+        load(board);
+        int c = chainOf[toPos(x, y)];
+        if (c < 0) return 0;
+        if (libs) {
+            libs[0] = toPoint(chainLib[c][0]);
+            libs[1] = toPoint(chainLib[c][1]);
+        }
+        return chainLibs[c];
+    }
+
+    // (x, y) 处棋串只剩一口气且轮到它走：是否无论怎么逃都会被征吃
+    bool isLadderCaptured(const Board& board, int x, int y) {
+        load(board);
+        int pos = toPos(x, y), c = chainOf[pos];
+        if (c < 0 || chainLibs[c] != 1) return false;
+        uint64_t key = cacheKey(c, 1);
+        CacheEntry& e = cacheSlot(key);
+        if (e.key == key) return e.answer != 0;
+        nodes = 0;
+        undoTop = 0;
+        bool lost = defenderLoses(pos, 0);
+        rollback(0);
+        e = {key, (int16_t)lost};
+        return lost;
+    }
+
+    // (x, y) 处棋串两口气且轮到对方走：能征死它的叫吃点，征不死返回 (-1, -1)
+    Point ladderAttack(const Board& board, int x, int y) {
+        load(board);
+        int pos = toPos(x, y), c = chainOf[pos];
+        if (c < 0 || chainLibs[c] != 2) return {-1, -1};
+        uint64_t key = cacheKey(c, 2);
+        CacheEntry& e = cacheSlot(key);
+        if (e.key != key) {
+            nodes = 0;
+            undoTop = 0;
+            int move = -1;
+            if (!attackerWins(pos, 0, &move)) move = -1;
+            rollback(0);
+            e = {key, (int16_t)move};
+        }
+        return e.answer < 0 ? Point{-1, -1} : toPoint(e.answer);
+    }
+};
+
+// 每线程一个征子读取器，缓存随线程保留
+LadderReader& ladderReader() {
+    thread_local LadderReader reader;
+    return reader;
+}
+
+// 围棋着法的战术分：提子、逃出叫吃 (征子逃不掉则不逃)、能征死对方的叫吃
+static float goTacticalScore(const Board& board, int x, int y, PieceType player) {
+    static const int dx[] = {0, 0, 1, -1};
+    static const int dy[] = {1, -1, 0, 0};
+    LadderReader& reader = ladderReader();
+    float score = 0;
+    int seen[4], seenCount = 0;
+    for (int k = 0; k < 4; ++k) {
+        int nx = x + dx[k], ny = y + dy[k];
+        PieceType p = board.getPiece(nx, ny);
+        if (p == EMPTY) continue;
+        int chain = reader.chainAt(board, nx, ny);
+        if (find(seen, seen + seenCount, chain) != seen + seenCount) continue;
+        seen[seenCount++] = chain;
+        int libs = reader.liberties(board, nx, ny, nullptr);
+        if (p != player && libs == 1) score += 3.0f;
+        else if (p == player && libs == 1) score += reader.isLadderCaptured(board, nx, ny) ? -2.0f : 2.0f;
+        else if (p != player && libs == 2 && reader.ladderAttack(board, nx, ny) == Point{x, y}) score += 2.5f;
+    }
+    return score;
+}
+
+// --- 围棋死活求解 (df-pn 证明数搜索) ---
+// 在局部区域内精确读取目标棋串的死活：攻方 (目标的对方) 要提掉目标，守方要做活。
+// 守方棋串成为 Benson 无条件活、或双方相继虚着时目标仍在，算守方成功。
+// 证明数 pn / 反证数 dn 都以"攻方成功"为命题：攻方走的节点取 pn 最小、dn 求和，守方节点相反。
+// 置换表为求解器自有的直接映射表；节点数超出预算时给出 UNKNOWN
+class TsumegoSolver : private TacticalBoard {
+public:
+    enum Outcome { KILLED, ALIVE, UNKNOWN };
+    // move 为先走方达成目标的着法；先走方无须落子 (可脱先) 时为 (-1, -1)，先走方失败时亦为 (-1, -1)
+    struct Result {
+        Outcome outcome = UNKNOWN;
+        Point move = {-1, -1};
+        long nodes = 0;
+        double ms = 0;
+    };
+    // 局部区域的点数上限：目标所在的封闭空间超过它就不算局部死活
+    static const int MAX_REGION = 48;
+
+private:
+    static constexpr uint32_t INF = 1u << 30;
+    static const int DEPTH_LIMIT = 160;
+    static const int PASS = -1;
+
+    struct Entry { uint64_t key; uint32_t pn, dn; };
+    struct Child { int16_t pos; uint64_t key; uint32_t pn, dn; };
+
+    vector<Entry> table;
+    uint64_t tableMask;
+    uint64_t salt = 0;
+    uint64_t solves = 0;
+    int target = 0, defender = BLACK, attacker = WHITE;
+    int16_t region[MAX_REGION];
+    int regionCount = 0;
+    long nodes = 0, nodeLimit = 0;
+    bool aborted = false;
+    int rootCount = 0;
+    vector<Child> children;   // 每层 MAX_REGION + 1 个，按深度分段复用
+    vector<int8_t> aliveArea;
+    int16_t work[CELLS];
+    int16_t libs[CELLS];
+
+    uint64_t positionKey(int toMove, int ko, int passes) const {
+        return hash ^ salt ^ (toMove == attacker ? 0xD1B54A32D192ED03ULL : 0)
+             ^ ((uint64_t)(ko + 1) * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t)passes << 60);
+    }
+    bool lookup(uint64_t key, uint32_t& pn, uint32_t& dn) const {
+        const Entry& e = table[key & tableMask];
+        if (e.key != key) return false;
+        pn = e.pn;
+        dn = e.dn;
+        return true;
+    }
+    void store(uint64_t key, uint32_t pn, uint32_t dn) { table[key & tableMask] = {key, pn, dn}; }
+
+    bool targetCaptured() const { return cell[target] != defender; }
+
+    // Benson 判活的必要条件：目标棋串至少有两块区域 (非守方点的连通块) 的空点全是它的气。
+    // 只在目标附近泛洪，多数局面在这里就被排除，不必做全盘分析
+    bool hasTwoVitalRegions() {
+        nextMark();
+        uint32_t chainStamp = markStamp;
+        int stones = 0, libCount = 0;
+        work[stones++] = (int16_t)target;
+        mark[target] = chainStamp;
+        for (int i = 0; i < stones; ++i)
+            for (int d : DIR) {
+                int q = work[i] + d;
+                if (cell[q] == defender && mark[q] != chainStamp) {
+                    mark[q] = chainStamp;
+                    work[stones++] = (int16_t)q;
+                } else if (cell[q] == EMPTY && libCount < CELLS) {
+                    libs[libCount++] = (int16_t)q;
+                }
+            }
+        nextMark();
+        if (markStamp <= chainStamp) return true; // 标记回绕，保守地交给 Benson
+        int vitalRegions = 0;
+        for (int i = 0; i < libCount; ++i) {
+            if (mark[libs[i]] == markStamp) continue;
+            int top = 0, size = 0;
+            bool vital = true;
+            stack[top++] = libs[i];
+            mark[libs[i]] = markStamp;
+            while (top > 0 && vital) {
+                int p = stack[--top];
+                if (++size > MAX_REGION) { vital = false; break; }
+                bool isLiberty = cell[p] != EMPTY;
+                for (int d : DIR) {
+                    int q = p + d;
+                    if (mark[q] == chainStamp) isLiberty = true;
+                    else if (cell[q] != defender && cell[q] != OFFBOARD && mark[q] != markStamp) {
+                        mark[q] = markStamp;
+                        stack[top++] = (int16_t)q;
+                    }
+                }
+                vital = isLiberty;
+            }
+            if (vital && ++vitalRegions >= 2) return true;
+        }
+        return false;
+    }
+
+    bool targetAlive() {
+        if (!hasTwoVitalRegions()) return false;
+        aliveArea.assign((size_t)n * n, 0);
+        bensonPassAlive(n, [this](int x, int y) {
+            return (x < 0 || y < 0 || x >= n || y >= n) ? 3 : (int)cell[toPos(x, y)];
+        }, (PieceType)defender, 1, aliveArea);
+        Point t = toPoint(target);
+        return aliveArea[t.x * n + t.y] != 0;
+    }
+
+    // 落子 (含提子)；自杀或撤销缓冲不足时撤回并返回 false。ko 写出新的劫禁点
+    bool tryPlay(int pos, int color, int& ko) {
+        int m = undoTop;
+        if (!play(pos, color)) return false;
+        int libs[2];
+        int nl = countLibs(pos, 1, libs);
+        if (nl == 0) { rollback(m); return false; }
+        // 单提一子且自身为单子单气：对方不能立即回提
+        ko = -1;
+        if (undoTop - m == 2 && nl == 1) {
+            bool single = true;
+            for (int d : DIR) single = single && cell[pos + d] != color;
+            if (single) ko = undo[m + 1].pos;
+        }
+        return true;
+    }
+
+    // 生成 toMove 方的候选 (区域内合法点 + 虚着)，并给出每个子局面的键与初值；返回个数
+    int expand(Child* out, int toMove, int ko, int passes) {
+        int count = 0, other = 3 - toMove;
+        for (int i = 0; i < regionCount; ++i) {
+            int pos = region[i], childKo;
+            if (cell[pos] != EMPTY || pos == ko) continue;
+            int m = undoTop;
+            if (!tryPlay(pos, toMove, childKo)) continue;
+            Child& c = out[count++];
+            c.pos = (int16_t)pos;
+            c.key = positionKey(other, childKo, 0);
+            if (targetCaptured()) { c.pn = 0; c.dn = INF; }
+            else if (!lookup(c.key, c.pn, c.dn)) { c.pn = 1; c.dn = 1; }
+            rollback(m);
+        }
+        Child& c = out[count++];
+        c.pos = PASS;
+        c.key = positionKey(other, -1, passes + 1);
+        if (passes + 1 >= 2) { c.pn = INF; c.dn = 0; }
+        else if (!lookup(c.key, c.pn, c.dn)) { c.pn = 1; c.dn = 1; }
+        return count;
+    }
+
+    static uint32_t addCapped(uint32_t a, uint32_t b) { return min(INF, a + b); }
+
+    // 多重迭代深化 (MID)：在阈值 (thpn, thdn) 内展开，返回节点的 (pn, dn)
+    void mid(uint32_t thpn, uint32_t thdn, int toMove, int ko, int passes, int depth, uint32_t& pn, uint32_t& dn) {
+        uint64_t key = positionKey(toMove, ko, passes);
+        if (++nodes > nodeLimit) aborted = true;
+        // 表中已有的局面做过终局判断 (Benson 分析较贵，只在首次到达时做)
+        if (lookup(key, pn, dn)) {
+            if (pn == 0 || dn == 0) return;
+        } else if (targetCaptured()) {
+            pn = 0; dn = INF; store(key, pn, dn); return;
+        } else if (passes >= 2 || targetAlive()) {
+            pn = INF; dn = 0; store(key, pn, dn); return;
+        }
+        // 深度到顶 (循环劫等) 按守方成功处理，不写表
+        if (depth >= DEPTH_LIMIT || aborted) { pn = INF; dn = 0; return; }
+
+        Child* kids = &children[(size_t)depth * (MAX_REGION + 1)];
+        int count = expand(kids, toMove, ko, passes);
+        if (depth == 0) rootCount = count;
+        bool orNode = toMove == attacker;
+        while (true) {
+            // 汇总子节点 (表里有更新的值时以表为准)
+            uint32_t best = INF + 1, second = INF + 1;
+            int bestIndex = 0;
+            pn = orNode ? INF : 0;
+            dn = orNode ? 0 : INF;
+            for (int i = 0; i < count; ++i) {
+                Child& c = kids[i];
+                lookup(c.key, c.pn, c.dn);
+                uint32_t v = orNode ? c.pn : c.dn;
+                if (v < best) { second = best; best = v; bestIndex = i; }
+                else if (v < second) second = v;
+                if (orNode) { pn = min(pn, c.pn); dn = addCapped(dn, c.dn); }
+                else { pn = addCapped(pn, c.pn); dn = min(dn, c.dn); }
+            }
+            store(key, pn, dn);
+            if (pn == 0 || dn == 0 || pn >= thpn || dn >= thdn || aborted) return;
+
+            Child& c = kids[bestIndex];
+            uint32_t cthpn, cthdn;
+            if (orNode) {
+                cthpn = min(thpn, second + 1);
+                cthdn = thdn - dn + c.dn;
             } else {
-                playerBlack = make_unique<AIPlayer>(getAIName(level) + "(B)", BLACK, level);
-                playerWhite = make_unique<HumanPlayer>(username, WHITE);
+                cthpn = thpn - pn + c.pn;
+                cthdn = min(thdn, second + 1);
+            }
+            int m = undoTop, childKo = -1;
+            if (c.pos == PASS) {
+                mid(cthpn, cthdn, 3 - toMove, -1, passes + 1, depth + 1, c.pn, c.dn);
+            } else {
+                tryPlay(c.pos, toMove, childKo);
+                mid(cthpn, cthdn, 3 - toMove, childKo, 0, depth + 1, c.pn, c.dn);
+                rollback(m);
+            }
+        }
+    }
+
+    // 目标所在的封闭空间 (空点与守方棋子的连通块) 中的空点，
+    // 加上紧贴它、气不多于两口的攻方棋串的气 (守方提外围子的着法)；空间过大返回 false
+    bool buildRegion() {
+        regionCount = 0;
+        nextMark();
+        int top = 0, seen = 0;
+        stack[top++] = (int16_t)target;
+        mark[target] = markStamp;
+        vector<int> walls;
+        while (top > 0) {
+            int p = stack[--top];
+            if (cell[p] == EMPTY) {
+                if (regionCount >= MAX_REGION) return false;
+                region[regionCount++] = (int16_t)p;
+            }
+            if (++seen > MAX_REGION * 3) return false;
+            for (int d : DIR) {
+                int q = p + d;
+                if (mark[q] == markStamp) continue;
+                if (cell[q] == EMPTY || cell[q] == defender) {
+                    mark[q] = markStamp;
+                    stack[top++] = (int16_t)q;
+                } else if (cell[q] == attacker) {
+                    walls.push_back(q);
+                }
+            }
+        }
+        for (int w : walls) {
+            int libs[2];
+            int nl = countLibs(w, 2, libs);
+            if (nl > 2) continue;
+            for (int i = 0; i < nl; ++i) {
+                int q = libs[i];
+                if (find(region, region + regionCount, q) != region + regionCount) continue;
+                if (regionCount >= MAX_REGION) return false;
+                region[regionCount++] = (int16_t)q;
+            }
+        }
+        // 目标的气排在前面：平局时 df-pn 先试紧气与长气
+        int libs[2];
+        int nl = min(countLibs(target, 1, libs), 2);
+        for (int i = 0; i < nl; ++i) {
+            int16_t* at = find(region, region + regionCount, libs[i]);
+            if (at != region + regionCount) swap(*at, region[i]);
+        }
+        return true;
+    }
+
+public:
+    explicit TsumegoSolver(int tableBits = 18)
+        : table((size_t)1 << tableBits), tableMask(((uint64_t)1 << tableBits) - 1),
+          children((size_t)(DEPTH_LIMIT + 1) * (MAX_REGION + 1)) {}
+
+    // (x, y) 处棋串的死活，toMove 先走，最多展开 nodeLimit 个节点
+    Result solve(const Board& board, Point stone, PieceType toMove, long limit = 200000) {
+        auto start = chrono::steady_clock::now();
+        Result result;
+        if (board.getPiece(stone.x, stone.y) == EMPTY) return result;
+        loadCells(board);
+        target = toPos(stone.x, stone.y);
+        defender = cell[target];
+        attacker = 3 - defender;
+        if (!buildRegion()) return result;
+        // 每次求解换一个盐，旧条目自然失效，不必清表
+        salt = (++solves) * 0xBF58476D1CE4E5B9ULL;
+        nodes = 0;
+        rootCount = 0;
+        nodeLimit = limit;
+        aborted = false;
+
+        uint32_t pn, dn;
+        mid(INF, INF, toMove, -1, 0, 0, pn, dn);
+        result.nodes = nodes;
+        if (pn == 0 || dn == 0) {
+            result.outcome = pn == 0 ? KILLED : ALIVE;
+            // 先走方成功时，从根的候选中取证明它的那一手
+            bool moverWins = (pn == 0) == (toMove == attacker);
+            if (moverWins) {
+                for (int i = 0; i < rootCount; ++i) {
+                    const Child& c = children[i];
+                    if ((pn == 0 ? c.pn : c.dn) == 0) {
+                        if (c.pos != PASS) result.move = toPoint(c.pos);
+                        break;
+                    }
+                }
+            }
+        }
+        result.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+// 每线程一个死活求解器 (置换表较大，随线程复用)
+TsumegoSolver& tsumegoSolver() {
+    thread_local TsumegoSolver solver;
+    return solver;
+}
+
+// 围棋局部死活的急所：某块封闭的棋"谁先走谁成功"时，player 在其中的关键着法 (杀对方或救自己)，
+// 同一急所关系到几块棋时记最大的一块；已定型的棋不必再走。budget 为全部求解合计的节点预算
+struct LocalFight {
+    Point move;
+    int stones; // 所涉棋串的子数
+};
+
+vector<LocalFight> localFights(const Board& board, PieceType player, long budget = 20000) {
+    static const int MIN_STONES = 3;
+    static const long NODES_PER_SOLVE = 8000;
+    static const int dx[] = {0, 0, 1, -1};
+    static const int dy[] = {1, -1, 0, 0};
+    int n = board.getSize();
+    TsumegoSolver& solver = tsumegoSolver();
+    vector<bool> seen((size_t)n * n, false);
+    vector<Point> chain;
+    vector<LocalFight> fights;
+    for (int i = 0; i < n && budget > 0; ++i)
+        for (int j = 0; j < n && budget > 0; ++j) {
+            PieceType owner = board.getPiece(i, j);
+            if (owner == EMPTY || seen[i * n + j]) continue;
+            chain.assign(1, {i, j});
+            seen[i * n + j] = true;
+            for (size_t h = 0; h < chain.size(); ++h)
+                for (int k = 0; k < 4; ++k) {
+                    int nx = chain[h].x + dx[k], ny = chain[h].y + dy[k];
+                    if (board.isValidBounds(nx, ny) && !seen[nx * n + ny] && board.getPiece(nx, ny) == owner) {
+                        seen[nx * n + ny] = true;
+                        chain.push_back({nx, ny});
+                    }
+                }
+            if ((int)chain.size() < MIN_STONES) continue;
+            // 我方先走能达成目标，且换对方先走结果相反，才是急所
+            TsumegoSolver::Outcome goal = owner == player ? TsumegoSolver::ALIVE : TsumegoSolver::KILLED;
+            TsumegoSolver::Result mine = solver.solve(board, {i, j}, player, min(budget, NODES_PER_SOLVE));
+            budget -= mine.nodes;
+            if (mine.outcome != goal || mine.move.x < 0 || budget <= 0) continue;
+            TsumegoSolver::Result theirs = solver.solve(board, {i, j}, getOpponent(player), min(budget, NODES_PER_SOLVE));
+            budget -= theirs.nodes;
+            if (theirs.outcome == TsumegoSolver::UNKNOWN || theirs.outcome == goal) continue;
+            auto same = find_if(fights.begin(), fights.end(), [&](const LocalFight& f) { return f.move == mine.move; });
+            if (same == fights.end()) fights.push_back({mine.move, (int)chain.size()});
+            else same->stones = max(same->stones, (int)chain.size());
+        }
+    return fights;
+}
+
+// --- 启发式着法评分 (贪心 AI 与 MCTS 先验共用) ---
+// 黑白棋位置权值表 (默认评估权值，亦用于着法排序)
+int positionWeight(int x, int y) {
+    static const int weights[8][8] = {
+        {100, -20, 10,  5,  5, 10, -20, 100},
+        {-20, -50, -2, -2, -2, -2, -50, -20},
+        { 10,  -2, -1, -1, -1, -1,  -2,  10},
+        {  5,  -2, -1, -1, -1, -1,  -2,   5},
+        {  5,  -2, -1, -1, -1, -1,  -2,   5},
+        { 10,  -2, -1, -1, -1, -1,  -2,  10},
+        {-20, -50, -2, -2, -2, -2, -50, -20},
+        {100, -20, 10,  5,  5, 10, -20, 100}
+    };
+    if (x < 8 && y < 8) return weights[x][y];
+    return 1;
+}
+
+// 邻近已有棋子的程度：五子棋/围棋中远离战斗的着法几乎不可能是好棋
+static float neighbourhoodScore(const Board& board, int x, int y) {
+    float score = 0;
+    for (int dx = -2; dx <= 2; ++dx) {
+        for (int dy = -2; dy <= 2; ++dy) {
+            if (dx == 0 && dy == 0) continue;
+            if (board.getPiece(x + dx, y + dy) == EMPTY) continue;
+            score += (abs(dx) <= 1 && abs(dy) <= 1) ? 1.0f : 0.4f;
+        }
+    }
+    return score;
+}
+
+// 各规则的着法启发分 (对数先验，数值越大越值得尝试)
+float moveHeuristic(const ReversiRule&, const Board&, int x, int y, PieceType) {
+    return positionWeight(x, y) / 25.0f;
+}
+float moveHeuristic(const GomokuRule&, const Board& board, int x, int y, PieceType) {
+    return neighbourhoodScore(board, x, y);
+}
+float moveHeuristic(const GoRule&, const Board& board, int x, int y, PieceType player) {
+    int n = board.getSize();
+    int edge = min(min(x, y), min(n - 1 - x, n - 1 - y));
+    float score = neighbourhoodScore(board, x, y) * 0.5f + goTacticalScore(board, x, y, player);
+    if (edge == 0) score -= 1.0f;       // 一线通常是坏棋
+    else if (edge == 2 || edge == 3) score += 0.5f;
+    return score;
+}
+
+// --- NNUE 式增量评估 (alpha-beta 搜索用) ---
+// 输入特征为 (交叉点, 己方/对方) 共 2*N*N 个稀疏二值特征，黑白两个视角各维护一个第一层累加器。
+// 累加器只随 makeMove 实际改动的格子 (五子棋一子，黑白棋落子加翻转) 增减对应列，
+// 悔着时整块弹出上一层，因此每个节点的评估代价与改动格数成正比，而不是与棋盘面积成正比。
+// 输出 = Σ outW[行棋方] · clip(acc[行棋方]) + Σ outW[对方] · clip(acc[对方]) + outB
+//
+// 权值文件 (小端，由 HW2 train-nnue 从自对弈样本训练写出)：32 字节文件头
+//   "NNU1" | u32 版本 | u32 面积 | u32 隐藏单元数 | i32 截断上限 | i32 输出偏置 | f32 输出比例 | 4 字节保留
+// 之后依次为 int16 featureW[2*面积][隐藏]、int16 featureB[隐藏]、int16 outW[2*隐藏]
+struct NnueWeights {
+    static const uint32_t VERSION = 1;
+    static constexpr int MAX_HIDDEN = 256;
+
+    int area = 0;
+    int hidden = 0;
+    int clipMax = 127;          // clipped ReLU 的上限
+    int32_t outB = 0;
+    float outScale = 1.0f;      // 输出换算为评估分的比例
+    bool trained = false;       // 读自权值文件 (否则由逐格权值表构造)
+    vector<int16_t> featureW;   // 特征 f 的列从 f * hidden 开始
+    vector<int16_t> featureB;
+    vector<int16_t> outW;       // 前 hidden 个对行棋方累加器，后 hidden 个对对方累加器
+
+    // 特征编号：perspective 视角下 cell 格上的 colour 棋子
+    static int feature(PieceType perspective, int cell, PieceType colour) {
+        return cell * 2 + (colour == perspective ? 0 : 1);
+    }
+
+    bool load(const string& path, int expectedArea) {
+        ifstream in(path, ios::binary);
+        if (!in.is_open()) return false;
+        char header[32];
+        if (!in.read(header, sizeof(header)) || memcmp(header, "NNU1", 4) != 0) return false;
+        uint32_t version, a, h;
+        memcpy(&version, header + 4, 4);
+        memcpy(&a, header + 8, 4);
+        memcpy(&h, header + 12, 4);
+        memcpy(&clipMax, header + 16, 4);
+        memcpy(&outB, header + 20, 4);
+        memcpy(&outScale, header + 24, 4);
+        if (version != VERSION || (int)a != expectedArea || h == 0 || h > (uint32_t)MAX_HIDDEN || clipMax <= 0)
+            return false;
+        area = (int)a;
+        hidden = (int)h;
+        featureW.resize((size_t)2 * area * hidden);
+        featureB.resize(hidden);
+        outW.resize((size_t)2 * hidden);
+        in.read(reinterpret_cast<char*>(featureW.data()), featureW.size() * sizeof(int16_t));
+        in.read(reinterpret_cast<char*>(featureB.data()), featureB.size() * sizeof(int16_t));
+        in.read(reinterpret_cast<char*>(outW.data()), outW.size() * sizeof(int16_t));
+        trained = (bool)in;
+        return trained;
+    }
+
+    bool save(const string& path) const {
+        ofstream out(path, ios::binary);
+        if (!out.is_open()) return false;
+        char header[32] = {};
+        uint32_t version = VERSION, a = (uint32_t)area, h = (uint32_t)hidden;
+        memcpy(header, "NNU1", 4);
+        memcpy(header + 4, &version, 4);
+        memcpy(header + 8, &a, 4);
+        memcpy(header + 12, &h, 4);
+        memcpy(header + 16, &clipMax, 4);
+        memcpy(header + 20, &outB, 4);
+        memcpy(header + 24, &outScale, 4);
+        out.write(header, sizeof(header));
+        out.write(reinterpret_cast<const char*>(featureW.data()), featureW.size() * sizeof(int16_t));
+        out.write(reinterpret_cast<const char*>(featureB.data()), featureB.size() * sizeof(int16_t));
+        out.write(reinterpret_cast<const char*>(outW.data()), outW.size() * sizeof(int16_t));
+        return (bool)out;
+    }
+
+    // 无训练权值时由逐格权值表构造一个等价的线性评估：
+    // 两个隐藏单元分别累加 OFFSET ± k·Σ(己方权值 - 对方权值)，截断区间内二者之差即为线性分；
+    // 定点倍数 k 取到满盘也不会越出截断区间为止
+    void buildFromTable(const vector<float>& cellWeights) {
+        const int OFFSET = 8192;
+        area = (int)cellWeights.size();
+        hidden = 2;
+        clipMax = 2 * OFFSET - 1;
+        float total = 0;
+        for (float v : cellWeights) total += fabs(v);
+        float k = total > 0 ? min(16.0f, (OFFSET - 1) / total) : 16.0f;
+        featureW.assign((size_t)2 * area * hidden, 0);
+        featureB.assign(hidden, OFFSET);
+        for (int cell = 0; cell < area; ++cell) {
+            int16_t w = (int16_t)lround(cellWeights[cell] * k);
+            int16_t* own = &featureW[(size_t)(cell * 2) * hidden];
+            int16_t* opp = &featureW[(size_t)(cell * 2 + 1) * hidden];
+            own[0] = w;  own[1] = (int16_t)-w;
+            opp[0] = (int16_t)-w; opp[1] = w;
+        }
+        // 对方视角的线性分恰为行棋方的相反数，两侧各贡献 2k·分
+        outW = {1, -1, -1, 1};
+        outB = 0;
+        outScale = 1.0f / (4 * k);
+    }
+};
+
+// 两个视角的第一层累加器；只用前 hidden 个单元
+struct NnueAccumulator {
+    alignas(32) int16_t values[2][NnueWeights::MAX_HIDDEN];
+};
+
+class NnueEvaluator {
+private:
+    const NnueWeights* w = nullptr;
+    vector<NnueAccumulator> stack;
+    int top = 0;
+    int size = 0;
+
+    void addColumn(int16_t* acc, int f) const {
+        const int16_t* col = &w->featureW[(size_t)f * w->hidden];
+        for (int j = 0; j < w->hidden; ++j) acc[j] += col[j];
+    }
+    void subColumn(int16_t* acc, int f) const {
+        const int16_t* col = &w->featureW[(size_t)f * w->hidden];
+        for (int j = 0; j < w->hidden; ++j) acc[j] -= col[j];
+    }
+
+public:
+    // 从整个棋盘重建根部累加器 (每次搜索开始时一次)
+    void reset(const NnueWeights* weights, const Board& board) {
+        w = weights;
+        size = board.getSize();
+        if (stack.empty()) stack.resize(64);
+        top = 0;
+        NnueAccumulator& acc = stack[0];
+        for (int side = 0; side < 2; ++side) {
+            PieceType perspective = side == 0 ? BLACK : WHITE;
+            copy(w->featureB.begin(), w->featureB.end(), acc.values[side]);
+            for (int i = 0; i < size; ++i)
+                for (int j = 0; j < size; ++j) {
+                    PieceType p = board.getPiece(i, j);
+                    if (p != EMPTY) addColumn(acc.values[side], NnueWeights::feature(perspective, i * size + j, p));
+                }
+        }
+    }
+
+    // 进入下一层：复制当前累加器，再按日志中 [from, end) 的改动增量更新
+    void push(const vector<BoardChange>& journal, size_t from) {
+        if (top + 1 >= (int)stack.size()) stack.resize(stack.size() * 2);
+        NnueAccumulator& next = stack[top + 1];
+        const NnueAccumulator& cur = stack[top];
+        for (int side = 0; side < 2; ++side)
+            copy(cur.values[side], cur.values[side] + w->hidden, next.values[side]);
+        top++;
+        for (size_t i = from; i < journal.size(); ++i) {
+            const BoardChange& c = journal[i];
+            int cell = c.x * size + c.y;
+            for (int side = 0; side < 2; ++side) {
+                PieceType perspective = side == 0 ? BLACK : WHITE;
+                if (c.before != EMPTY) subColumn(next.values[side], NnueWeights::feature(perspective, cell, c.before));
+                if (c.after != EMPTY) addColumn(next.values[side], NnueWeights::feature(perspective, cell, c.after));
+            }
+        }
+    }
+    void pop() { top--; }
+
+    // 行棋方视角的评估分
+    int evaluate(PieceType sideToMove) const {
+        const NnueAccumulator& acc = stack[top];
+        const int16_t* us = acc.values[sideToMove == BLACK ? 0 : 1];
+        const int16_t* them = acc.values[sideToMove == BLACK ? 1 : 0];
+        int h = w->hidden, clipMax = w->clipMax;
+        int32_t sum = w->outB;
+        for (int j = 0; j < h; ++j) {
+            sum += (int32_t)w->outW[j] * min(max((int)us[j], 0), clipMax);
+            sum += (int32_t)w->outW[h + j] * min(max((int)them[j], 0), clipMax);
+        }
+        return (int)lround(sum * w->outScale);
+    }
+};
+
+// 评估分与胜率的换算尺度：P(行棋方胜) = sigmoid(分 / EVAL_WIN_SCALE)，调优与搜索共用
+const double EVAL_WIN_SCALE = 50.0;
+
+// 默认逐格评估权值：黑白棋 8x8 用位置权值表，其余棋盘按离中心的远近给出温和的偏好
+vector<float> cellWeightTable(GameType type, int n) {
+    vector<float> table((size_t)n * n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            if (type == REVERSI && n == 8) {
+                table[i * n + j] = (float)positionWeight(i, j);
+            } else {
+                int edge = min(min(i, j), min(n - 1 - i, n - 1 - j));
+                table[i * n + j] = (float)min(edge, 4);
+            }
+        }
+    return table;
+}
+
+static const char* gameFileTag(GameType type) {
+    return type == GOMOKU ? "gomoku" : (type == GO ? "go" : "reversi");
+}
+
+string nnueFileName(GameType type, int n) {
+    return string("nnue_") + gameFileTag(type) + "_" + to_string(n) + ".bin";
+}
+
+string evalWeightsFileName(GameType type, int n) {
+    return string("eval_") + gameFileTag(type) + "_" + to_string(n) + ".txt";
+}
+
+// 调优得到的逐格权值文件 (文本)：首行 "EVW1 <棋盘尺寸>"，之后 N 行每行 N 个权值
+bool readEvalWeights(const string& path, int n, vector<float>& out) {
+    ifstream in(path);
+    string magic;
+    int size;
+    if (!(in >> magic >> size) || magic != "EVW1" || size != n) return false;
+    vector<float> table((size_t)n * n);
+    for (auto& v : table)
+        if (!(in >> v)) return false;
+    out.swap(table);
+    return true;
+}
+
+bool writeEvalWeights(const string& path, int n, const vector<float>& table) {
+    ofstream out(path);
+    if (!out.is_open()) return false;
+    out << "EVW1 " << n << "\n" << fixed << setprecision(2);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) out << (j ? " " : "") << table[i * n + j];
+        out << "\n";
+    }
+    return (bool)out;
+}
+
+// 贪心 AI 与 alpha-beta 评估共用的逐格权值：优先读调优结果，没有则用默认表
+const vector<float>& loadEvalWeights(GameType type, int n) {
+    static mutex mtx;
+    static map<pair<int, int>, vector<float>> cache;
+    lock_guard<mutex> lock(mtx);
+    auto key = make_pair((int)type, n);
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        vector<float> table;
+        if (!readEvalWeights(evalWeightsFileName(type, n), n, table)) table = cellWeightTable(type, n);
+        it = cache.emplace(key, std::move(table)).first;
+    }
+    return it->second;
+}
+
+// 每种棋、每种尺寸一份权值，首次使用时加载；文件不存在时由逐格评估权值构造
+const NnueWeights* loadNnueForGame(GameType type, int n) {
+    static mutex mtx;
+    static map<pair<int, int>, unique_ptr<NnueWeights>> cache;
+    lock_guard<mutex> lock(mtx);
+    auto key = make_pair((int)type, n);
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        unique_ptr<NnueWeights> weights = make_unique<NnueWeights>();
+        if (!weights->load(nnueFileName(type, n), n * n)) weights->buildFromTable(loadEvalWeights(type, n));
+        it = cache.emplace(key, std::move(weights)).first;
+    }
+    return it->second.get();
+}
+
+// --- MCTS 节点结构 ---
+// --- 子节点选择内核：一次算出一组兄弟的 UCT / PUCT 得分并取最大者 ---
+// 父节点访问次数的 sqrt(log N) (UCT) 与 sqrt(N) (PUCT) 查表；子节点的倒数在向量寄存器里直接算。
+// opti[i] <= optiLimit 的子节点已证明不可能更好，不参与比较；全部排除时返回 -1。
+// 未访问的子节点在 UCT 中得分为无穷大，同分时取下标最小者 (与逐个比较的结果一致)
+struct SelectTables {
+    static const int SIZE = 1 << 16;
+    vector<float> sqrtLog, sqrtN;
+    SelectTables() : sqrtLog(SIZE), sqrtN(SIZE) {
+        for (int n = 0; n < SIZE; ++n) {
+            sqrtLog[n] = n > 1 ? sqrtf(logf((float)n)) : 0.0f;
+            sqrtN[n] = sqrtf((float)n);
+        }
+    }
+};
+static const SelectTables selectTables;
+
+static float parentSqrtLog(int n) {
+    return n < SelectTables::SIZE ? selectTables.sqrtLog[max(n, 0)] : sqrtf(logf((float)n));
+}
+static float parentSqrt(int n) {
+    return n < SelectTables::SIZE ? selectTables.sqrtN[max(n, 0)] : sqrtf((float)n);
+}
+
+// explore = c * sqrt(log N)：score = w / n + explore / sqrt(n)
+static int selectUctScalar(const int* visits, const float* wins, const int8_t* opti, int count,
+                           int8_t optiLimit, float explore) {
+    int best = -1;
+    float bestValue = -std::numeric_limits<float>::infinity();
+    for (int i = 0; i < count; ++i) {
+        if (opti[i] <= optiLimit) continue;
+        if (visits[i] == 0) return i;
+        float inv = 1.0f / (float)visits[i];
+        float score = wins[i] * inv + explore * sqrtf(inv);
+        if (score > bestValue) {
+            bestValue = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// explore = c * sqrt(N)：score = (n > 0 ? w / n : fpu) + explore * prior / (1 + n)
+static int selectPuctScalar(const int* visits, const float* wins, const float* prior, const int8_t* opti,
+                            int count, int8_t optiLimit, float explore, float fpu) {
+    int best = -1;
+    float bestValue = -std::numeric_limits<float>::infinity();
+    for (int i = 0; i < count; ++i) {
+        if (opti[i] <= optiLimit) continue;
+        float v = (float)visits[i];
+        float q = visits[i] > 0 ? wins[i] / v : fpu;
+        float score = q + explore * prior[i] / (1.0f + v);
+        if (score > bestValue) {
+            bestValue = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+#ifdef HW2_X86_SIMD
+// 8 路的最大值与其下标归约：同分取下标最小者
+__attribute__((target("avx2")))
+static void reduceArgmax(__m256 best, __m256i bestIdx, float& value, int& index) {
+    float lanes[8];
+    int idx[8];
+    _mm256_storeu_ps(lanes, best);
+    _mm256_storeu_si256((__m256i*)idx, bestIdx);
+    for (int k = 0; k < 8; ++k)
+        if (idx[k] >= 0 && (lanes[k] > value || (lanes[k] == value && idx[k] < index))) {
+            value = lanes[k];
+            index = idx[k];
+        }
+}
+
+// 排除的子节点得分置为负无穷
+__attribute__((target("avx2")))
+static __m256 keepMask(const int8_t* opti, __m256i limit) {
+    __m256i o = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)opti));
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(o, limit));
+}
+
+__attribute__((target("avx2")))
+static int selectUctAVX2(const int* visits, const float* wins, const int8_t* opti, int count,
+                         int8_t optiLimit, float explore) {
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256 ninf = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    const __m256 one = _mm256_set1_ps(1.0f), k = _mm256_set1_ps(explore);
+    const __m256i limit = _mm256_set1_epi32(optiLimit), step = _mm256_set1_epi32(8);
+    __m256 best = ninf;
+    __m256i bestIdx = _mm256_set1_epi32(-1), idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int i = 0;
+    for (; i + 8 <= count; i += 8, idx = _mm256_add_epi32(idx, step)) {
+        __m256i vi = _mm256_loadu_si256((const __m256i*)(visits + i));
+        __m256 inv = _mm256_div_ps(one, _mm256_cvtepi32_ps(vi));
+        __m256 score = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(wins + i), inv),
+                                     _mm256_mul_ps(k, _mm256_sqrt_ps(inv)));
+        __m256 unvisited = _mm256_castsi256_ps(_mm256_cmpeq_epi32(vi, _mm256_setzero_si256()));
+        score = _mm256_blendv_ps(score, inf, unvisited);
+        score = _mm256_blendv_ps(ninf, score, keepMask(opti + i, limit));
+        __m256 gt = _mm256_cmp_ps(score, best, _CMP_GT_OQ);
+        best = _mm256_blendv_ps(best, score, gt);
+        bestIdx = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIdx), _mm256_castsi256_ps(idx), gt));
+    }
+    float bestValue = -std::numeric_limits<float>::infinity();
+    int bestIndex = -1;
+    reduceArgmax(best, bestIdx, bestValue, bestIndex);
+    for (; i < count; ++i) {
+        if (opti[i] <= optiLimit) continue;
+        float score = std::numeric_limits<float>::infinity();
+        if (visits[i] > 0) {
+            float inv = 1.0f / (float)visits[i];
+            score = wins[i] * inv + explore * sqrtf(inv);
+        }
+        if (score > bestValue) {
+            bestValue = score;
+            bestIndex = i;
+        }
+    }
+    return bestValue == -std::numeric_limits<float>::infinity() ? -1 : bestIndex;
+}
+
+__attribute__((target("avx2")))
+static int selectPuctAVX2(const int* visits, const float* wins, const float* prior, const int8_t* opti,
+                          int count, int8_t optiLimit, float explore, float fpu) {
+    const __m256 ninf = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    const __m256 one = _mm256_set1_ps(1.0f), k = _mm256_set1_ps(explore), vfpu = _mm256_set1_ps(fpu);
+    const __m256i limit = _mm256_set1_epi32(optiLimit), step = _mm256_set1_epi32(8);
+    __m256 best = ninf;
+    __m256i bestIdx = _mm256_set1_epi32(-1), idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int i = 0;
+    for (; i + 8 <= count; i += 8, idx = _mm256_add_epi32(idx, step)) {
+        __m256i vi = _mm256_loadu_si256((const __m256i*)(visits + i));
+        __m256 v = _mm256_cvtepi32_ps(vi);
+        __m256 unvisited = _mm256_castsi256_ps(_mm256_cmpeq_epi32(vi, _mm256_setzero_si256()));
+        __m256 q = _mm256_blendv_ps(_mm256_div_ps(_mm256_loadu_ps(wins + i), v), vfpu, unvisited);
+        __m256 u = _mm256_div_ps(_mm256_mul_ps(k, _mm256_loadu_ps(prior + i)), _mm256_add_ps(one, v));
+        __m256 score = _mm256_blendv_ps(ninf, _mm256_add_ps(q, u), keepMask(opti + i, limit));
+        __m256 gt = _mm256_cmp_ps(score, best, _CMP_GT_OQ);
+        best = _mm256_blendv_ps(best, score, gt);
+        bestIdx = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIdx), _mm256_castsi256_ps(idx), gt));
+    }
+    float bestValue = -std::numeric_limits<float>::infinity();
+    int bestIndex = -1;
+    reduceArgmax(best, bestIdx, bestValue, bestIndex);
+    int tail = selectPuctScalar(visits + i, wins + i, prior + i, opti + i, count - i, optiLimit, explore, fpu);
+    if (tail >= 0) {
+        float v = (float)visits[i + tail];
+        float q = visits[i + tail] > 0 ? wins[i + tail] / v : fpu;
+        if (q + explore * prior[i + tail] / (1.0f + v) > bestValue) bestIndex = i + tail;
+    }
+    return bestIndex;
+}
+#endif
+
+typedef int (*SelectUctFn)(const int*, const float*, const int8_t*, int, int8_t, float);
+typedef int (*SelectPuctFn)(const int*, const float*, const float*, const int8_t*, int, int8_t, float, float);
+
+static bool cpuHasAVX2() {
+#ifdef HW2_X86_SIMD
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+#ifdef HW2_X86_SIMD
+static const SelectUctFn selectUct = cpuHasAVX2() ? selectUctAVX2 : selectUctScalar;
+static const SelectPuctFn selectPuct = cpuHasAVX2() ? selectPuctAVX2 : selectPuctScalar;
+#else
+static const SelectUctFn selectUct = selectUctScalar;
+static const SelectPuctFn selectPuct = selectPuctScalar;
+#endif
+
+// --- MCTS 搜索树：节点以 32 位下标编号，各字段分开存放 (SoA) ---
+// 扩展时一次性为全部子节点分配连续的下标，一组兄弟的 visits / wins / prior 在各自数组里相邻，
+// 选择时顺序扫过这几段内存，而不是逐个访问节点对象。整棵树由搜索的树锁保护
+struct MCTSTree {
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+    enum : uint8_t { EXPANDED = 1, EXPANDING = 2 }; // EXPANDING: 已有线程在评估并负责扩展该节点
+
+    // 选择时读取的统计量
+    vector<int> visits;
+    vector<float> wins;   // 针对 playerMoved 的胜场价值累加
+    vector<float> prior;  // 先验概率 (PUCT)
+    // 已证明的结果界 (MCTS-Solver，带和棋的界版本)：以 playerMoved 为视角，-1 负 / 0 和 / +1 胜。
+    // pess 为至少能得到的结果，opti 为至多能得到的结果，两者相等即已证明
+    vector<int8_t> pess, opti;
+    // 结构与其余字段
+    vector<uint32_t> firstChild; // 子节点的起始下标，未扩展时为 NONE
+    vector<uint16_t> childCount;
+    vector<Point> move;          // 到达此节点的落子 ((-1,-1) 为虚着)
+    vector<int8_t> playerMoved;  // 谁落子到达了这里
+    vector<uint8_t> flags;
+
+    size_t size() const { return visits.size(); }
+    void clear() {
+        visits.clear(); wins.clear(); prior.clear(); pess.clear(); opti.clear();
+        firstChild.clear(); childCount.clear(); move.clear(); playerMoved.clear(); flags.clear();
+    }
+    uint32_t add(Point m, PieceType player, float p) {
+        visits.push_back(0);
+        wins.push_back(0.0f);
+        prior.push_back(p);
+        pess.push_back(-1);
+        opti.push_back(1);
+        firstChild.push_back(NONE);
+        childCount.push_back(0);
+        move.push_back(m);
+        playerMoved.push_back((int8_t)player);
+        flags.push_back(0);
+        return (uint32_t)(size() - 1);
+    }
+    // 为 node 创建全部子节点 (priors 为空时先验记 0)
+    void expand(uint32_t node, const vector<Point>& moves, const vector<float>& priors, PieceType player) {
+        uint32_t first = (uint32_t)size();
+        for (size_t k = 0; k < moves.size(); ++k) add(moves[k], player, priors.empty() ? 0.0f : priors[k]);
+        firstChild[node] = first;
+        childCount[node] = (uint16_t)moves.size();
+        flags[node] = EXPANDED;
+    }
+
+    bool expanded(uint32_t n) const { return flags[n] & EXPANDED; }
+    uint32_t childEnd(uint32_t n) const { return firstChild[n] + childCount[n]; }
+    bool proven(uint32_t n) const { return pess[n] == opti[n]; }
+    void prove(uint32_t n, int8_t outcome) { pess[n] = opti[n] = outcome; }
+    double mean(uint32_t n) const { return visits[n] > 0 ? wins[n] / visits[n] : -1.0; }
+
+    // 把以 node 为根的子树按层序复制到 out (下标从 0 重新编号)，其余分支丢弃。
+    // 先求出层序，再逐个字段整段搬运
+    void extractSubtree(uint32_t node, MCTSTree& out) const {
+        vector<uint32_t> order = {node};
+        vector<uint32_t> newFirst;
+        for (size_t head = 0; head < order.size(); ++head) {
+            uint32_t from = order[head];
+            newFirst.push_back(expanded(from) ? (uint32_t)order.size() : NONE);
+            if (expanded(from))
+                for (uint32_t c = firstChild[from]; c < childEnd(from); ++c) order.push_back(c);
+        }
+        size_t m = order.size();
+        auto gather = [&](auto& dst, const auto& src) {
+            dst.resize(m);
+            for (size_t k = 0; k < m; ++k) dst[k] = src[order[k]];
+        };
+        gather(out.visits, visits);
+        gather(out.wins, wins);
+        gather(out.prior, prior);
+        gather(out.pess, pess);
+        gather(out.opti, opti);
+        gather(out.childCount, childCount);
+        gather(out.move, move);
+        gather(out.playerMoved, playerMoved);
+        gather(out.flags, flags);
+        out.firstChild.swap(newFirst);
+        for (auto& f : out.flags) f &= EXPANDED;
+    }
+
+    // 由子节点的界推出本节点的界 (轮到走的一方取子节点中最好的)，界有变化时返回 true
+    bool updateBounds(uint32_t n) {
+        if (!expanded(n) || childCount[n] == 0) return false;
+        int8_t bestPess = -1, bestOpti = -1;
+        for (uint32_t c = firstChild[n]; c < childEnd(n); ++c) {
+            bestPess = max(bestPess, pess[c]);
+            bestOpti = max(bestOpti, opti[c]);
+        }
+        int8_t newPess = (int8_t)-bestOpti, newOpti = (int8_t)-bestPess;
+        bool changed = newPess != pess[n] || newOpti != opti[n];
+        pess[n] = newPess;
+        opti[n] = newOpti;
+        return changed;
+    }
+    // 轮到走的一方已有保证的结果 (-opti 即子节点 pess 的最大值)；
+    // 至多也只能达到这个结果的子节点不必再搜索
+    bool prunable(uint32_t n, uint32_t child) const { return opti[child] <= -opti[n]; }
+
+    // UCT 选择公式 (Upper Confidence Bound for Trees)
+    // 未访问的子节点优先，扩展时已随机打乱顺序，相当于随机扩展未尝试的着法
+    uint32_t bestChild(uint32_t n, double cParam = 1.414) const {
+        uint32_t first = firstChild[n];
+        int k = selectUct(&visits[first], &wins[first], &opti[first], childCount[n], (int8_t)-opti[n],
+                          (float)cParam * parentSqrtLog(visits[n]));
+        return k < 0 ? NONE : first + k;
+    }
+
+    // PUCT 选择公式：Q + c * P * sqrt(N) / (1 + n)
+    // 未访问子节点的 Q 取父节点自身估值 (First Play Urgency)
+    uint32_t bestChildPUCT(uint32_t n, double cPuct) const {
+        uint32_t first = firstChild[n];
+        float fpu = visits[n] > 0 ? 1.0f - wins[n] / visits[n] : 0.5f;
+        int k = selectPuct(&visits[first], &wins[first], &prior[first], &opti[first], childCount[n],
+                           (int8_t)-opti[n], (float)cPuct * parentSqrt(visits[n]), fpu);
+        return k < 0 ? NONE : first + k;
+    }
+};
+
+// --- 跨进程共享的置换表：放在 POSIX 共享内存里，同一台机器上的各引擎进程共用 ---
+// 无锁：每个表项两个 64 位字 (key ^ data, data)，读出后异或校验，写入被并发打断时校验失败视为未命中。
+// MCTS 估值与 alpha-beta 的界用不同的键，同一局面的两种表项并存、互不覆盖。
+// 表项格式 (版本 2)，data 的各位：
+//   0-31  数值：alpha-beta 为相对本节点的分数 (int32)；MCTS 为行棋方胜率 (float)
+//   32-47 alpha-beta 为最佳着法的格子编号 + 1 (0 为无)；MCTS 为访问次数 (封顶 65535)
+//   48-55 权重：alpha-beta 为搜索深度，MCTS 为 log2(访问次数)
+//   56-58 种类 (Kind)
+//   59-63 写入时的代数 (每次搜索开始时全表代数加一)，替换时旧表项的权重按代差打折
+// 格式改动时须增加 VERSION；版本或构建不同 (评估函数可能不同，分数不可比) 的进程拒绝挂接同一段共享内存。
+// 段由第一个进程独占创建并定下大小，之后的进程大小不符即拒绝；最后一个退出的进程删除它
+class SharedTable {
+public:
+    enum Kind : uint8_t { EMPTY_ENTRY = 0, EXACT = 1, LOWER = 2, UPPER = 3, MCTS_VALUE = 4 };
+    struct Entry {
+        Kind kind = EMPTY_ENTRY;
+        int32_t score = 0;    // alpha-beta
+        int move = -1;        // alpha-beta 最佳着法的格子编号
+        float value = 0;      // MCTS
+        int visits = 0;       // MCTS
+        int weight = 0;
+    };
+
+    static const uint32_t MAGIC = 0x54543248; // "H2TT"
+    static const uint32_t VERSION = 2;
+    static const int BUCKET = 4;              // 每组 4 项，正好一个缓存行
+
+private:
+    struct Header {
+        atomic<uint32_t> magic;
+        uint32_t version;
+        uint64_t buckets;
+        uint64_t build;                // 创建者的构建标记
+        atomic<uint32_t> generation;
+        atomic<uint32_t> users;        // 挂接中的进程数
+        uint8_t pad[32];
+    };
+    struct Slot {
+        atomic<uint64_t> check;  // key ^ data
+        atomic<uint64_t> data;
+    };
+    static_assert(sizeof(Header) == 64, "header is one cache line");
+
+    Header* header = nullptr;
+    Slot* slots = nullptr;
+    size_t length = 0;
+    uint64_t bucketMask = 0;
+    string segment;
+
+    // 构建标记：编译时刻的哈希
+    static uint64_t buildStamp() {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (const char* c = __DATE__ " " __TIME__; *c; ++c) h = (h ^ (uint8_t)*c) * 0x100000001B3ULL;
+        return h;
+    }
+    static uint64_t slotKey(uint64_t key, Kind kind) {
+        return kind == MCTS_VALUE ? key ^ 0x6A09E667F3BCC909ULL : key;
+    }
+
+    static uint64_t pack(const Entry& e, uint32_t gen) {
+        uint32_t low;
+        uint64_t mid;
+        if (e.kind == MCTS_VALUE) {
+            memcpy(&low, &e.value, 4);
+            mid = (uint64_t)min(e.visits, 65535);
+        } else {
+            low = (uint32_t)e.score;
+            mid = (uint64_t)(e.move + 1) & 0xFFFF;
+        }
+        return (uint64_t)low | mid << 32 | (uint64_t)(min(max(e.weight, 0), 255)) << 48 |
+               (uint64_t)e.kind << 56 | (uint64_t)(gen & 31) << 59;
+    }
+    static Entry unpack(uint64_t d) {
+        Entry e;
+        e.kind = (Kind)((d >> 56) & 7);
+        uint32_t low = (uint32_t)d;
+        int mid = (int)((d >> 32) & 0xFFFF);
+        if (e.kind == MCTS_VALUE) {
+            memcpy(&e.value, &low, 4);
+            e.visits = mid;
+        } else {
+            e.score = (int32_t)low;
+            e.move = mid - 1;
+        }
+        e.weight = (int)((d >> 48) & 0xFF);
+        return e;
+    }
+
+public:
+    SharedTable() {}
+    SharedTable(const SharedTable&) = delete;
+    SharedTable& operator=(const SharedTable&) = delete;
+    ~SharedTable() {
+#ifndef _WIN32
+        if (!header) return;
+        bool last = header->users.fetch_sub(1) == 1;
+        munmap(header, length);
+        if (last) shm_unlink(segment.c_str());
+#endif
+    }
+
+    // 挂接 (不存在时创建) 名为 name、容量约 megabytes 的共享内存段
+    bool open(const string& name, size_t megabytes) {
+#ifdef _WIN32
+        (void)name; (void)megabytes;
+        return false;
+#else
+        // 组数取 2 的幂，便于按掩码定位
+        uint64_t buckets = 1;
+        while (buckets * 2 * BUCKET * sizeof(Slot) <= megabytes * 1024 * 1024) buckets *= 2;
+        size_t size = sizeof(Header) + buckets * BUCKET * sizeof(Slot);
+        // 最后一个进程正在退出删除旧段时，重试直到能创建新段
+        for (int attempt = 0; attempt < 100; ++attempt) {
+            bool creator = true;
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0 && errno == EEXIST) {
+                creator = false;
+                fd = shm_open(name.c_str(), O_RDWR, 0600);
+                if (fd < 0 && errno == ENOENT) continue;
+            }
+            if (fd < 0) return false;
+            if (creator) {
+                if (ftruncate(fd, size) != 0) {
+                    ::close(fd);
+                    shm_unlink(name.c_str());
+                    return false;
+                }
+            } else {
+                // 创建者可能还没定下大小；大小不同的段不能截断 (其他进程正映射着它)，只能拒绝
+                struct stat st;
+                int waited = 0;
+                while (fstat(fd, &st) == 0 && st.st_size == 0 && waited++ < 1000)
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                if (st.st_size == 0 || (size_t)st.st_size != size) {
+                    ::close(fd);
+                    return false;
+                }
+            }
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED) {
+                if (creator) shm_unlink(name.c_str());
+                return false;
+            }
+            Header* h = static_cast<Header*>(p);
+            if (creator) {
+                h->version = VERSION;
+                h->build = buildStamp();
+                h->buckets = buckets;
+                h->users.store(1);
+                h->magic.store(MAGIC, memory_order_release);
+            } else {
+                int waited = 0;
+                while (h->magic.load(memory_order_acquire) == 0 && waited++ < 1000)
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                bool compatible = h->magic.load(memory_order_acquire) == MAGIC && h->version == VERSION &&
+                                  h->build == buildStamp() && h->buckets == buckets;
+                // users 已归零说明最后一个进程正在删除这个段，不能再挂上去
+                if (!compatible || h->users.fetch_add(1) == 0) {
+                    if (compatible) h->users.fetch_sub(1);
+                    munmap(p, size);
+                    if (!compatible) return false;
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                    continue;
+                }
+            }
+            header = h;
+            length = size;
+            segment = name;
+            slots = reinterpret_cast<Slot*>(header + 1);
+            bucketMask = buckets - 1;
+            return true;
+        }
+        return false;
+#endif
+    }
+
+    bool isOpen() const { return header != nullptr; }
+    size_t bytes() const { return length; }
+
+    // 每次搜索开始时调用，使之前写入的表项逐渐变旧
+    void newSearch() { header->generation.fetch_add(1, memory_order_relaxed); }
+
+    // 局面键：棋盘 Zobrist 哈希，再混入棋种、尺寸与行棋方
+    static uint64_t positionKey(const Board& board, GameType type, PieceType toMove) {
+        uint64_t salt = (uint64_t)type << 16 | (uint64_t)board.getSize() << 4 | (uint64_t)toMove;
+        salt = (salt + 0x9E3779B97F4A7C15ULL) * 0xBF58476D1CE4E5B9ULL;
+        salt ^= salt >> 31;
+        return board.getHash() ^ salt;
+    }
+
+    // kind 为 MCTS_VALUE 时查 MCTS 估值，为其余种类时查 alpha-beta 的界
+    bool probe(uint64_t key, Kind kind, Entry& out) const {
+        key = slotKey(key, kind);
+        const Slot* bucket = slots + (key & bucketMask) * BUCKET;
+        for (int i = 0; i < BUCKET; ++i) {
+            uint64_t d = bucket[i].data.load(memory_order_relaxed);
+            uint64_t c = bucket[i].check.load(memory_order_relaxed);
+            if (d != 0 && (c ^ d) == key) {
+                out = unpack(d);
+                return (out.kind == MCTS_VALUE) == (kind == MCTS_VALUE);
+            }
+        }
+        return false;
+    }
+
+    // 同键 (同一局面的同一类表项) 直接覆盖；否则先用空位，再替换 (权重 - 4 × 代差) 最小的一项
+    void store(uint64_t key, const Entry& e) {
+        key = slotKey(key, e.kind);
+        uint32_t gen = header->generation.load(memory_order_relaxed);
+        Slot* bucket = slots + (key & bucketMask) * BUCKET;
+        Slot* victim = nullptr;
+        int victimScore = std::numeric_limits<int>::max();
+        for (int i = 0; i < BUCKET; ++i) {
+            uint64_t d = bucket[i].data.load(memory_order_relaxed);
+            uint64_t c = bucket[i].check.load(memory_order_relaxed);
+            if (d == 0 || (c ^ d) == key) {
+                victim = &bucket[i];
+                break;
+            }
+            int age = (int)((gen - (uint32_t)(d >> 59)) & 31);
+            int score = (int)((d >> 48) & 0xFF) - 4 * age;
+            if (score < victimScore) {
+                victimScore = score;
+                victim = &bucket[i];
+            }
+        }
+        uint64_t d = pack(e, gen);
+        victim->check.store(key ^ d, memory_order_relaxed);
+        victim->data.store(d, memory_order_relaxed);
+    }
+};
+
+// 进程内唯一的共享置换表，未挂接时为空
+static unique_ptr<SharedTable> sharedTableInstance;
+SharedTable* sharedTable() { return sharedTableInstance.get(); }
+
+bool openSharedTable(size_t megabytes) {
+    auto table = make_unique<SharedTable>();
+    if (!table->open("/hw2-shared-tt", megabytes)) return false;
+    sharedTableInstance = std::move(table);
+    return true;
+}
+
+// 规则对应的棋种 (模板化的引擎据此生成置换表的局面键)
+GameType ruleGameType(const GomokuRule&) { return GOMOKU; }
+GameType ruleGameType(const GoRule&) { return GO; }
+GameType ruleGameType(const ReversiRule&) { return REVERSI; }
+
+// --- 搜索引擎 ---
+// 虚函数接口只保留在 UI 边界 (AIPlayer)，引擎内部模板化在具体规则类型上，
+// 热点函数 (isValidMove / makeMove) 静态分派并可内联
+// 最近一次搜索的根节点统计 (自对弈据此记录访问分布)
+struct SearchStats {
+    int iterations = 0;
+    double rootValue = 0.5; // 行棋方视角的胜率 (最佳着法的平均价值)
+    vector<Point> moves;    // 根节点各子节点的着法
+    vector<int> visits;     // 对应的访问次数
+    // MCTS：对应着法已证明的结果界 (行棋方视角 -1 负 / 0 和 / +1 胜)，相等即已证明
+    vector<int8_t> lower, upper;
+    vector<float> ownership; // 围棋：随机模拟终局的逐点归属期望 (黑 +1 / 白 -1)，无模拟时为空
+    double expectedScore = 0; // 围棋：黑方领先目数的期望 (已计贴目)
+};
+
+class SearchEngine {
+protected:
+    SearchStats stats;
+public:
+    virtual ~SearchEngine() {}
+    virtual Point search(const Board& board, const GameRule& rule, PieceType player) = 0;
+    const SearchStats& lastStats() const { return stats; }
+};
+
+// 枚举 player 的全部合法落子
+template<class Rule>
+void collectMoves(Rule& rule, int size, PieceType player, vector<Point>& out) {
+    out.clear();
+    for(int i=0; i<size; ++i)
+        for(int j=0; j<size; ++j)
+            if(rule.isValidMove(i, j, player)) out.push_back({i, j});
+}
+
+// --- 围棋 3x3 图案权值表：以"行棋方为黑"的视角，按图案码 (GoRule::patternCode) 直接查表 ---
+// 默认权值由几条常识规则生成 (贴身接触、断点、尖、空三角、空旷的一线)；
+// 若存在 go_patterns.txt (每行 "图案码 权值")，其中的条目覆盖默认值
+class GoPatternTable {
+private:
+    vector<float> weights;
+
+    static float defaultWeight(uint16_t code) {
+        int v[8];
+        for (int k = 0; k < 8; ++k) v[k] = (code >> (2 * k)) & 3;
+        // 正交邻点 (-1,0) (0,-1) (0,1) (1,0) 与对角邻点 (-1,-1) (-1,1) (1,-1) (1,1)
+        const int orth[4] = {v[1], v[3], v[4], v[6]};
+        const int diag[4] = {v[0], v[2], v[5], v[7]};
+        int own = 0, opp = 0, off = 0, ownDiag = 0, oppDiag = 0;
+        for (int o : orth) { own += o == BLACK; opp += o == WHITE; off += o == 3; }
+        for (int d : diag) { ownDiag += d == BLACK; oppDiag += d == WHITE; }
+        if (own + off == 4) return 0.05f;              // 自己的眼
+        if (opp + off == 4) return 0.1f;               // 对方的眼，多半不能下
+        float w = 1.0f;
+        if (opp > 0) w *= 3.0f;                        // 贴身接触
+        if (own > 0 && opp > 0) w *= 1.5f;             // 断点 / 粘
+        if (own == 0 && opp == 0 && ownDiag + oppDiag > 0) w *= 1.5f; // 尖、小飞一类的连接
+        // 空三角：相邻两个正交方向与夹在中间的对角都是己方
+        const int corner[4][3] = {{v[1], v[3], v[0]}, {v[1], v[4], v[2]}, {v[6], v[3], v[5]}, {v[6], v[4], v[7]}};
+        for (auto& c : corner)
+            if (c[0] == BLACK && c[1] == BLACK && c[2] == BLACK) w *= 0.3f;
+        if (off > 0 && own + opp + ownDiag + oppDiag == 0) w *= 0.5f; // 空旷的边线
+        return w;
+    }
+
+public:
+    GoPatternTable() : weights(1 << 16) {
+        for (int code = 0; code < (1 << 16); ++code) weights[code] = defaultWeight((uint16_t)code);
+        ifstream in("go_patterns.txt");
+        int code;
+        float w;
+        while (in >> code >> w)
+            if (code >= 0 && code < (1 << 16)) weights[code] = w;
+    }
+    // player 在图案码为 code 的点落子的权值
+    float weight(uint16_t code, PieceType player) const {
+        return weights[player == BLACK ? code : GoRule::swapColours(code)];
+    }
+};
+
+const GoPatternTable& goPatterns() {
+    static const GoPatternTable table;
+    return table;
+}
+
+// 随机模拟的着法过滤：围棋不填自己的眼 (四周都是己方棋子或棋盘边)，否则活棋会被自己填死，
+// 模拟终局的归属也就没有意义；也不在已无条件活的区域内落子；其余规则不过滤
+template<class Rule>
+bool isRolloutCandidate(const Rule&, const Board&, int, int, PieceType) { return true; }
+bool isRolloutCandidate(const GoRule& rule, const Board& board, int x, int y, PieceType player) {
+    if (rule.isSettled(x, y)) return false; // 已无条件确定归属的区域不必再下
+    static const int dx[] = {0, 0, 1, -1};
+    static const int dy[] = {1, -1, 0, 0};
+    for (int k = 0; k < 4; ++k) {
+        int nx = x + dx[k], ny = y + dy[k];
+        if (board.isValidBounds(nx, ny) && board.getPiece(nx, ny) != player) return true;
+    }
+    return false;
+}
+
+// 模拟策略着法，(-1, -1) 表示随机落子。围棋：上一手及其相邻棋串只剩一两口气时，
+// 依次优先提子、逃出叫吃 (征子逃不掉则不逃)、能征死对方时叫吃
+template<class Rule>
+Point rolloutPolicyMove(Rule&, const Board&, PieceType, Point) { return {-1, -1}; }
+Point rolloutPolicyMove(GoRule& rule, const Board& board, PieceType player, Point last) {
+    if (last.x < 0) return {-1, -1};
+    static const int dx[] = {0, 0, 0, 1, -1};
+    static const int dy[] = {0, 1, -1, 0, 0};
+    LadderReader& reader = ladderReader();
+    Point capture = {-1, -1}, escape = {-1, -1}, attack = {-1, -1};
+    for (int k = 0; k < 5; ++k) {
+        int x = last.x + dx[k], y = last.y + dy[k];
+        PieceType p = board.getPiece(x, y);
+        if (p == EMPTY) continue;
+        Point libs[2];
+        int nl = reader.liberties(board, x, y, libs);
+        if (p != player && nl == 1) capture = libs[0];
+        else if (p == player && nl == 1 && escape.x < 0 && !reader.isLadderCaptured(board, x, y)) escape = libs[0];
+        else if (p != player && nl == 2 && attack.x < 0) attack = reader.ladderAttack(board, x, y);
+    }
+    for (Point m : {capture, escape, attack})
+        if (m.x >= 0 && isRolloutCandidate(rule, board, m.x, m.y, player) && rule.isValidMove(m.x, m.y, player))
+            return m;
+    return {-1, -1};
+}
+
+// 随机模拟的落子抽样：按随机顺序试探空点，第一个合法的即是在全部合法着法中均匀抽取，
+// 通常只需检查一两个点；无子可下返回 (-1, -1)
+template<class Rule>
+Point sampleRolloutMove(FastRandom& rng, vector<Point>& moves, Rule& rule, const Board& board, PieceType player) {
+    int size = board.getSize();
+    moves.clear();
+    for(int i=0; i<size; ++i)
+        for(int j=0; j<size; ++j)
+            if(board.getPiece(i, j) == EMPTY) moves.push_back({i, j});
+    for(int remaining = (int)moves.size(); remaining > 0; --remaining) {
+        int k = rng.below(remaining);
+        Point p = moves[k];
+        if(isRolloutCandidate(rule, board, p.x, p.y, player) && rule.isValidMove(p.x, p.y, player)) return p;
+        moves[k] = moves[remaining - 1];
+    }
+    return {-1, -1};
+}
+// 围棋按 3x3 图案权值抽样：每个空点一次查表，抽中的点不合法时剔除后重抽
+Point sampleRolloutMove(FastRandom& rng, vector<Point>& moves, GoRule& rule, const Board& board, PieceType player) {
+    thread_local vector<float> weights;
+    const GoPatternTable& patterns = goPatterns();
+    int size = board.getSize();
+    moves.clear();
+    weights.clear();
+    float total = 0;
+    for(int i=0; i<size; ++i)
+        for(int j=0; j<size; ++j) {
+            if(board.getPiece(i, j) != EMPTY) continue;
+            float w = patterns.weight(rule.patternCode(i, j), player);
+            if(w <= 0) continue;
+            moves.push_back({i, j});
+            weights.push_back(w);
+            total += w;
+        }
+    while(!moves.empty()) {
+        float r = (float)(rng.next() * (1.0 / 4294967296.0)) * total;
+        size_t k = 0;
+        while(k + 1 < moves.size() && r >= weights[k]) r -= weights[k++];
+        Point p = moves[k];
+        if(isRolloutCandidate(rule, board, p.x, p.y, player) && rule.isValidMove(p.x, p.y, player)) return p;
+        total -= weights[k];
+        moves[k] = moves.back();
+        weights[k] = weights.back();
+        moves.pop_back();
+        weights.pop_back();
+    }
+    return {-1, -1};
+}
+
+// 模拟过程中定期刷新规则的辅助状态 (围棋：无条件活的区域只增不减，每隔若干手重算一次)
+template<class Rule>
+void refreshRolloutState(Rule&, int) {}
+void refreshRolloutState(GoRule& rule, int depth) {
+    if (depth % 32 == 0) rule.refreshSettledArea();
+}
+
+// --- 最后好应手 (Last-Good-Reply with Forgetting, LGRF-2)：记住模拟中赢家对前一两手的应手 ---
+// 每个搜索线程一组表：二阶表按 [应手方][上上手][上一手] 索引，一阶表按 [应手方][上一手] 索引。
+// 一次迭代结束后，树内路径与随机模拟连成的整条着法序列中，赢家的应手写入两张表，
+// 输家的应手若正是表中的那一手则删去；之后的模拟先查二阶表、再查一阶表，应手仍合法时直接照下
+struct ReplyTable {
+    int n = 0;
+    size_t cells = 0;          // n*n + 1，末位代表虚着 (或搜索根之前未知的一手)
+    vector<int16_t> reply1[3]; // 应手的格子编号，-1 为无
+    vector<int16_t> reply2[3];
+    vector<Point> played;      // 本次迭代的着法序列 (首项为树内路径之前的一手)
+    PieceType first = BLACK;   // played[1] 由谁走出
+
+    void reset(int size) {
+        n = size;
+        cells = (size_t)n * n + 1;
+        for (PieceType p : {BLACK, WHITE}) {
+            reply1[p].assign(cells, -1);
+            reply2[p].assign(cells * cells, -1);
+        }
+    }
+    int index(Point p) const { return p.x < 0 ? n * n : p.x * n + p.y; }
+
+    // 迭代开始：line 为根之后沿树内路径的着法，lineFirst 为根局面的行棋方
+    void begin(const vector<Point>& line, PieceType lineFirst) {
+        played.assign(1, {-1, -1});
+        played.insert(played.end(), line.begin(), line.end());
+        first = lineFirst;
+    }
+    // player 对当前最后两手的应手：先二阶、后一阶，返回候选个数
+    int lookup(PieceType player, Point out[2]) const {
+        size_t last = index(played.back());
+        int second = played.size() >= 2 ? reply2[player][index(played[played.size() - 2]) * cells + last] : -1;
+        int single = reply1[player][last];
+        int count = 0;
+        if (second >= 0) out[count++] = {second / n, second % n};
+        if (single >= 0 && single != second) out[count++] = {single / n, single % n};
+        return count;
+    }
+    // result 为黑方视角的结果，0.5 (和棋或无法判断) 时不学习
+    void learn(double result) {
+        if (result == 0.5) return;
+        PieceType winner = result > 0.5 ? BLACK : WHITE;
+        PieceType player = first;
+        for (size_t i = 1; i < played.size(); ++i, player = getOpponent(player)) {
+            if (played[i].x < 0) continue;
+            int16_t m = (int16_t)index(played[i]);
+            size_t last = index(played[i - 1]);
+            int16_t* slots[2] = {&reply1[player][last], i >= 2 ? &reply2[player][index(played[i - 2]) * cells + last] : nullptr};
+            for (int16_t* r : slots) {
+                if (!r) continue;
+                if (player == winner) *r = m;
+                else if (*r == m) *r = -1;
+            }
+        }
+    }
+};
+
+// 从当前局面随机模拟至多 maxDepth 手 (虚着不计) 或到终局，规则与棋盘就地推进；
+// last 为进入模拟前的最后一手。每手之前调用 stop(depth, player, last)，返回 true 时提前结束。
+// 给出应手表 (调用方已 begin) 时，战术着法之后优先照表应对，并记录着法序列供模拟结束后学习
+template<class Rule, class Stop>
+void randomPlayout(FastRandom& rng, vector<Point>& moves, Rule& rule, const Board& board,
+                   PieceType player, int maxDepth, Point last, ReplyTable* replies, Stop stop) {
+    int depth = 0;
+    refreshRolloutState(rule, depth);
+    // 终局状态由 makeMove 增量维护 (五连/满盘/双方连续虚着)
+    while(depth < maxDepth && !rule.isTerminal() && !stop(depth, player, last)) {
+        Point m = rolloutPolicyMove(rule, board, player, last);
+        if(m.x < 0 && replies) {
+            Point r[2];
+            int count = replies->lookup(player, r);
+            for(int k = 0; k < count && m.x < 0; ++k)
+                if(isRolloutCandidate(rule, board, r[k].x, r[k].y, player) && rule.isValidMove(r[k].x, r[k].y, player)) m = r[k];
+        }
+        if(m.x < 0) m = sampleRolloutMove(rng, moves, rule, board, player);
+        if(replies) replies->played.push_back(m);
+        if(m.x < 0) {
+            rule.makeMove(-1, -1, player); // 虚着 Pass
+            last = m;
+            player = getOpponent(player);
+            continue;
+        }
+        rule.makeMove(m.x, m.y, player);
+        last = m;
+        player = getOpponent(player);
+        depth++;
+        refreshRolloutState(rule, depth);
+    }
+}
+
+template<class Rule>
+void randomPlayout(FastRandom& rng, vector<Point>& moves, Rule& rule, const Board& board,
+                   PieceType player, int maxDepth) {
+    randomPlayout(rng, moves, rule, board, player, maxDepth, {-1, -1}, nullptr,
+                  [](int, PieceType, Point) { return false; });
+}
+
+// 模拟终局的逐点归属 (只对围棋有意义)；margin 为黑方领先的目数 (已计贴目)
+template<class Rule>
+bool rolloutOwnership(const Rule&, vector<int8_t>&, float&) { return false; }
+bool rolloutOwnership(const GoRule& rule, vector<int8_t>& owner, float& margin) {
+    rule.finalOwnership(owner);
+    margin = -GoRule::KOMI;
+    for (int8_t o : owner) margin += o;
+    return true;
+}
+
+// --- 随机模拟的提前终止：局面已定时直接给出胜负，或在指定深度改用静态评估 ---
+// 每个搜索线程一份，模拟开始时由 rolloutCutoffBegin 重置
+struct RolloutCutoff {
+    const vector<float>* weights = nullptr; // 静态评估的逐格权值 (黑白棋)
+    int mercyMargin = 0;                    // 双方子数差达到它即判局面已定，0 为不用
+    Point fives[3][2];                      // 五子棋：各方再下一子即成五的空点 (两个以上即不可挡)
+    int fiveCount[3] = {0, 0, 0};
+    float margin = 0;                       // 围棋：截断处黑方领先的目数 (由 rollout 算好后再取静态评估)
+};
+
+// 各棋默认是否使用最后好应手：只有五子棋实测有收益 (冲四、活三的应手局部且固定)；
+// 黑白棋一手翻转大片棋子，同一应手换个局面就不再好，实测反而变弱；围棋 19 路实测持平，默认不开
+template<class Rule>
+bool defaultLastGoodReply(const Rule&) { return false; }
+bool defaultLastGoodReply(const GomokuRule&) { return true; }
+
+// 各棋默认的子数差阈值 (占棋盘格数的比例)：围棋随机模拟中大块被提即胜负已分，其余不用
+template<class Rule>
+double defaultMercyFraction(const Rule&) { return 0; }
+double defaultMercyFraction(const GoRule&) { return 0.25; }
+
+// 静态评估用的逐格权值：只有黑白棋使用
+template<class Rule>
+const vector<float>* rolloutEvalWeights(const Rule&, int) { return nullptr; }
+const vector<float>* rolloutEvalWeights(const ReversiRule&, int n) { return &loadEvalWeights(REVERSI, n); }
+
+// 根节点的局部战斗：只有围棋由死活求解器读出急所，随机模拟最容易在这里读错
+template<class Rule>
+vector<LocalFight> rootLocalFights(const Rule&, const Board&, PieceType, long) { return {}; }
+vector<LocalFight> rootLocalFights(const GoRule&, const Board& board, PieceType player, long budget) {
+    return localFights(board, player, budget);
+}
+
+// 五子棋：color 在 (x, y) 落子能否沿 (dx, dy) 方向成五
+static bool completesFive(const Board& board, int x, int y, int dx, int dy, PieceType color) {
+    int count = 1;
+    for (int i = 1; i < 5 && board.getPiece(x + i * dx, y + i * dy) == color; ++i) count++;
+    for (int i = 1; i < 5 && board.getPiece(x - i * dx, y - i * dy) == color; ++i) count++;
+    return count >= 5;
+}
+static const int FIVE_DIRECTIONS[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+
+static void addFivePoint(RolloutCutoff& c, PieceType color, int x, int y) {
+    int& k = c.fiveCount[color];
+    for (int i = 0; i < k; ++i)
+        if (c.fives[color][i].x == x && c.fives[color][i].y == y) return;
+    if (k < 2) c.fives[color][k++] = {x, y};
+}
+
+// 去掉已被占据的成五点
+static void pruneFivePoints(RolloutCutoff& c, const Board& board, PieceType color) {
+    int k = 0;
+    for (int i = 0; i < c.fiveCount[color]; ++i)
+        if (board.getPiece(c.fives[color][i].x, c.fives[color][i].y) == EMPTY) c.fives[color][k++] = c.fives[color][i];
+    c.fiveCount[color] = k;
+}
+
+// 模拟开始：五子棋先找出盘面上双方已有的成五点，之后只需检查每手所在的四条线
+template<class Rule>
+void rolloutCutoffBegin(const Rule&, const Board&, RolloutCutoff&) {}
+void rolloutCutoffBegin(const GomokuRule&, const Board& board, RolloutCutoff& c) {
+    c.fiveCount[BLACK] = c.fiveCount[WHITE] = 0;
+    int n = board.getSize();
+    for (int x = 0; x < n; ++x)
+        for (int y = 0; y < n; ++y) {
+            if (board.getPiece(x, y) != EMPTY) continue;
+            for (auto& dir : FIVE_DIRECTIONS) {
+                PieceType p = board.getPiece(x + dir[0], y + dir[1]);
+                if (p == EMPTY) p = board.getPiece(x - dir[0], y - dir[1]);
+                if (p != EMPTY && completesFive(board, x, y, dir[0], dir[1], p)) addFivePoint(c, p, x, y);
+                // 两侧颜色不同时另一方也可能成五
+                PieceType q = board.getPiece(x - dir[0], y - dir[1]);
+                if (q != EMPTY && q != p && completesFive(board, x, y, dir[0], dir[1], q)) addFivePoint(c, q, x, y);
+            }
+        }
+}
+
+// 局面已定时返回黑方视角的结果 (1 / 0)，否则返回 -1；toMove 为下一手的一方，last 为上一手
+template<class Rule>
+double rolloutDecided(const Rule&, const Board& board, PieceType, Point, RolloutCutoff& c) {
+    if (c.mercyMargin <= 0) return -1;
+    int diff = board.countPieces(BLACK) - board.countPieces(WHITE);
+    if (diff >= c.mercyMargin) return 1.0;
+    if (-diff >= c.mercyMargin) return 0.0;
+    return -1;
+}
+// 五子棋：轮到的一方已有成五点则下一手即胜；刚走的一方有两个成五点则无法同时堵住
+double rolloutDecided(const GomokuRule&, const Board& board, PieceType toMove, Point last, RolloutCutoff& c) {
+    PieceType mover = getOpponent(toMove);
+    pruneFivePoints(c, board, toMove);
+    if (c.fiveCount[toMove] > 0) return toMove == BLACK ? 1.0 : 0.0;
+    if (last.x < 0) return -1;
+    pruneFivePoints(c, board, mover);
+    // 新的成五点只可能出现在经过上一手的线上，且沿同一方向成五
+    for (auto& dir : FIVE_DIRECTIONS)
+        for (int i = -4; i <= 4; ++i) {
+            int x = last.x + i * dir[0], y = last.y + i * dir[1];
+            if (i != 0 && board.isValidBounds(x, y) && board.getPiece(x, y) == EMPTY &&
+                completesFive(board, x, y, dir[0], dir[1], mover))
+                addFivePoint(c, mover, x, y);
+        }
+    if (c.fiveCount[mover] >= 2) return mover == BLACK ? 1.0 : 0.0;
+    return -1;
+}
+
+// 静态评估：黑方胜率。默认按逐格权值 (没有则按子数) 的差值换算
+template<class Rule>
+double rolloutStaticValue(const Rule&, const Board& board, PieceType, RolloutCutoff& c) {
+    int n = board.getSize();
+    double score = 0;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            PieceType p = board.getPiece(i, j);
+            if (p == EMPTY) continue;
+            double w = c.weights ? (*c.weights)[i * n + j] : 1.0;
+            score += p == BLACK ? w : -w;
+        }
+    return 1.0 / (1.0 + exp(-score / EVAL_WIN_SCALE));
+}
+// 五子棋棋形分 (黑方视角)：按各方连子的长度与两端是否为空累计。
+// 每段连子只落在一条整线 (横、竖、两条斜线) 上，总分即各条整线的分数之和
+// 从 (sx, sy) 出发沿 (dx, dy) 扫描整条线
+int gomokuLineScore(const Board& board, int sx, int sy, int dx, int dy) {
+    // shape[长度][空端数]
+    static const int shape[5][3] = {{0, 0, 0}, {0, 0, 1}, {0, 2, 8}, {0, 8, 60}, {0, 60, 400}};
+    int score = 0;
+    bool emptyBefore = false; // 上一格为空 (线的起点之前是盘外)
+    for (int x = sx, y = sy; board.isValidBounds(x, y);) {
+        PieceType p = board.getPiece(x, y);
+        if (p == EMPTY) {
+            emptyBefore = true;
+            x += dx; y += dy;
+            continue;
+        }
+        int len = 0;
+        while (board.isValidBounds(x, y) && board.getPiece(x, y) == p) { len++; x += dx; y += dy; }
+        int open = emptyBefore + (board.isValidBounds(x, y) && board.getPiece(x, y) == EMPTY);
+        int v = shape[min(len, 4)][open];
+        score += p == BLACK ? v : -v;
+        emptyBefore = false;
+    }
+    return score;
+}
+
+// 经过 (x, y) 的 (dx, dy) 方向整线的起点
+static void gomokuLineStart(int n, int x, int y, int dx, int dy, int& sx, int& sy) {
+    int back = n;
+    if (dx > 0) back = min(back, x);
+    if (dx < 0) back = min(back, n - 1 - x);
+    if (dy > 0) back = min(back, y);
+    if (dy < 0) back = min(back, n - 1 - y);
+    sx = x - back * dx;
+    sy = y - back * dy;
+}
+
+double gomokuShapeScore(const Board& board, PieceType toMove) {
+    int n = board.getSize();
+    double score = 0;
+    for (auto& dir : FIVE_DIRECTIONS)
+        for (int x = 0; x < n; ++x)
+            for (int y = 0; y < n; ++y) {
+                if (board.isValidBounds(x - dir[0], y - dir[1])) continue; // 只从整线的起点计一次
+                score += gomokuLineScore(board, x, y, dir[0], dir[1]);
+            }
+    // 先手的一方棋形更容易兑现
+    score += toMove == BLACK ? 10 : -10;
+    return score;
+}
+
+// 棋形分的增量维护 (alpha-beta 叶节点用)：落子只改动经过该格的 4 条整线，
+// 压栈时按棋盘日志重算这几条线，弹栈时恢复旧分，叶节点评估不再扫描整个棋盘
+class GomokuShapeTracker {
+private:
+    int n = 0;
+    int total = 0;
+    vector<int> lineScore;             // [方向][起点格]
+    vector<pair<int, int>> undo;       // (线下标, 旧分)
+    vector<size_t> marks;
+
+public:
+    void reset(const Board& board) {
+        n = board.getSize();
+        lineScore.assign((size_t)4 * n * n, 0);
+        undo.clear();
+        marks.clear();
+        total = 0;
+        for (int d = 0; d < 4; ++d)
+            for (int x = 0; x < n; ++x)
+                for (int y = 0; y < n; ++y) {
+                    if (board.isValidBounds(x - FIVE_DIRECTIONS[d][0], y - FIVE_DIRECTIONS[d][1])) continue;
+                    int v = gomokuLineScore(board, x, y, FIVE_DIRECTIONS[d][0], FIVE_DIRECTIONS[d][1]);
+                    lineScore[(size_t)d * n * n + x * n + y] = v;
+                    total += v;
+                }
+    }
+
+    void push(const Board& board, const vector<BoardChange>& journal, size_t from) {
+        marks.push_back(undo.size());
+        for (size_t i = from; i < journal.size(); ++i) {
+            for (int d = 0; d < 4; ++d) {
+                int sx, sy;
+                gomokuLineStart(n, journal[i].x, journal[i].y, FIVE_DIRECTIONS[d][0], FIVE_DIRECTIONS[d][1], sx, sy);
+                int line = d * n * n + sx * n + sy;
+                int v = gomokuLineScore(board, sx, sy, FIVE_DIRECTIONS[d][0], FIVE_DIRECTIONS[d][1]);
+                if (v == lineScore[line]) continue;
+                undo.push_back({line, lineScore[line]});
+                total += v - lineScore[line];
+                lineScore[line] = v;
+            }
+        }
+    }
+
+    void pop() {
+        for (size_t i = undo.size(); i > marks.back(); --i) {
+            total += undo[i - 1].second - lineScore[undo[i - 1].first];
+            lineScore[undo[i - 1].first] = undo[i - 1].second;
+        }
+        undo.resize(marks.back());
+        marks.pop_back();
+    }
+
+    // 与 gomokuShapeScore 相同
+    double score(PieceType toMove) const { return total + (toMove == BLACK ? 10 : -10); }
+};
+const double GOMOKU_SHAPE_SCALE = 100.0; // 棋形分与胜率的换算尺度
+double rolloutStaticValue(const GomokuRule&, const Board& board, PieceType toMove, RolloutCutoff&) {
+    return 1.0 / (1.0 + exp(-gomokuShapeScore(board, toMove) / GOMOKU_SHAPE_SCALE));
+}
+// 围棋：按面积计分的领先目数 (已计贴目) 换算，尺度随棋盘大小放大
+double rolloutStaticValue(const GoRule&, const Board& board, PieceType, RolloutCutoff& c) {
+    double scale = max(1.0, board.getSize() * board.getSize() / 20.0);
+    return 1.0 / (1.0 + exp(-c.margin / scale));
+}
+
+// --- 围棋归属估计：从给定局面做若干次随机模拟，统计每点的终局归属 ---
+struct OwnershipEstimate {
+    vector<float> ownership;  // 每点归属的期望，黑 +1 / 白 -1
+    float expectedScore = 0;  // 黑方领先目数的期望 (已计贴目)
+    int samples = 0;
+};
+
+// 各线程分摊模拟次数，各自统计后合并
+OwnershipEstimate estimateOwnership(const Board& board, const GoRule& rule, PieceType toMove,
+                                    int playouts, uint64_t seed) {
+    int n = board.getSize();
+    int T = max(1, min(playouts, (int)thread::hardware_concurrency()));
+    vector<vector<int>> sums(T, vector<int>((size_t)n * n, 0));
+    vector<double> margins(T, 0.0);
+    auto work = [&](int t) {
+        FastRandom rng(seed + t);
+        vector<int8_t> owner;
+        vector<Point> moves;
+        for (int k = t; k < playouts; k += T) {
+            Board simBoard(board);
+            GoRule simRule(rule);
+            simRule.setBoard(&simBoard);
+            simRule.resync(0); // 终局后估计时忽略已有的连续虚着
+            // 双方轮流先走，抵消先手的偏差
+            randomPlayout(rng, moves, simRule, simBoard, k % 2 ? getOpponent(toMove) : toMove, 2 * n * n);
+            float margin;
+            rolloutOwnership(simRule, owner, margin);
+            for (size_t i = 0; i < owner.size(); ++i) sums[t][i] += owner[i];
+            margins[t] += margin;
+        }
+    };
+    vector<thread> helpers;
+    for (int t = 1; t < T; ++t) helpers.emplace_back(work, t);
+    work(0);
+    for (auto& th : helpers) th.join();
+
+    OwnershipEstimate est;
+    est.samples = playouts;
+    est.ownership.assign((size_t)n * n, 0.0f);
+    if (playouts <= 0) return est;
+    double marginSum = 0;
+    for (int t = 0; t < T; ++t) {
+        for (size_t i = 0; i < est.ownership.size(); ++i) est.ownership[i] += sums[t][i];
+        marginSum += margins[t];
+    }
+    for (auto& o : est.ownership) o /= playouts;
+    est.expectedScore = (float)(marginSum / playouts);
+    return est;
+}
+
+// 终局点目前判定死子：无条件活区域内的对方棋子直接判死，无条件活的棋串直接判活；
+// 其余棋子按归属估计，明显偏向对方的视为死子。est 已有本局面的估计 (来自搜索的模拟统计) 时直接使用，
+// 否则仅在有无法直接判定的棋子时做 playouts 次随机模拟并写回 est。返回提走的子数
+int markDeadStones(Board& board, const GoRule& rule, PieceType toMove, OwnershipEstimate& est, int playouts = 128) {
+    int n = board.getSize(), removed = 0;
+    vector<int8_t> settled;
+    rule.passAliveArea(settled);
+    bool undecided = false;
+    for (int p = 0; p < n * n && !undecided; ++p)
+        undecided = settled[p] == 0 && board.getPiece(p / n, p % n) != EMPTY;
+    if (undecided && est.ownership.size() != (size_t)n * n)
+        est = estimateOwnership(board, rule, toMove, playouts,
+                                (uint64_t)chrono::steady_clock::now().time_since_epoch().count());
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            PieceType p = board.getPiece(i, j);
+            if (p == EMPTY) continue;
+            int sign = p == BLACK ? 1 : -1;
+            bool dead = settled[i * n + j] != 0 ? settled[i * n + j] != sign
+                                                : est.ownership[i * n + j] * sign < -0.3f;
+            if (dead) {
+                board.setPiece(i, j, EMPTY);
+                removed++;
+            }
+        }
+    return removed;
+}
+
+struct MCTSConfig {
+    int timeLimitMs = 2000;
+    bool usePUCT = false;  // false: 经典 UCT；true: 带先验的 PUCT
+    double cUct = 1.414;
+    double cPuct = 1.5;
+    int playoutLimit = 0;  // >0 时达到该模拟次数即停止 (与时间限制先到者为准)
+    int threads = 1;       // 共享一棵树的搜索线程数
+    int virtualLoss = 3;   // 在途路径上临时计入的失败次数，使各线程分散到不同分支
+    int batchSize = 32;    // 网络批量评估的批大小 (多线程且有网络时启用)
+    int batchWaitUs = 500; // 凑批的最长等待时间
+    int rolloutDepth = 60; // 随机模拟的步数上限 (防止性能耗尽)，到达后按比分判定
+    int evalDepth = 0;     // >0 时模拟到这么多步即改用静态评估的胜率，代替其余部分
+    bool earlyCutoff = true;    // 模拟中局面已定 (五子棋不可挡的成五点、子数差过大) 时提前结束
+    double mercyFraction = -1;  // 子数差阈值占棋盘格数的比例；<0 用各棋的默认值，0 不用
+    // 根节点按顺序减半 (Sequential Halving) 分配模拟：先验最高的若干着法平分预算，
+    // 每轮淘汰平均价值较差的一半；根以下仍用 UCT/PUCT。适合预算很小的搜索
+    bool rootHalving = false;
+    int halvingWidth = 16; // 第一轮参与比较的着法数
+    int lastGoodReply = -1;     // 随机模拟使用各线程的最后好应手表：1 用，0 不用，<0 用各棋的默认值
+    bool reuseTree = true;      // 下一手从上次搜索中对应局面的子树继续搜索 (根的先验按需补算)
+    bool numaAware = true;      // 多 NUMA 节点的机器上每个节点一棵树 (根并行)，线程绑在本节点
+    bool useSharedTable = true; // 已挂接共享置换表时：搜索结束写入根及其子节点的估值，叶节点先查表
+    int sharedMinVisits = 64;   // 表中估值的访问次数不少于它才代替随机模拟
+    // 围棋：搜索开始时在根局面上求解局部死活 (计入思考时间)，急所作为根子节点的先验知识：
+    // 先验至少为 fightPrior，并预先计入 fightVisits 次胜局；之后仍由搜索与其他着法比较
+    long fightNodes = 20000;    // 死活求解的节点预算，0 为不用
+    float fightPrior = 0.5f;
+    int fightVisits = 20;
+};
+
+template<class Rule>
+class MCTSEngine : public SearchEngine {
+private:
+    // 每个搜索线程的私有状态
+    struct Worker {
+        FastRandom rng;
+        vector<Point> moves;
+        // 随机模拟终局的归属统计 (围棋)，线程结束时并入引擎
+        vector<int8_t> owner;
+        vector<int> ownershipSum;
+        int ownershipSamples = 0;
+        double marginSum = 0;
+        RolloutCutoff cutoff;
+        bool lastGoodReply = false;
+        ReplyTable replies;
+        explicit Worker(uint64_t seed) : rng(seed) {}
+    };
+
+    // 一次迭代选出的叶节点及其评估
+    struct LeafJob {
+        vector<uint32_t> path;   // 根到叶 (均已计入虚拟损失)
+        vector<Point> line;      // 根之后沿路径的着法 (选择时抄出，评估时不必访问树)
+        PieceType leafMover;     // 叶节点的 playerMoved
+        PieceType player;        // 叶节点轮到谁下
+        bool expand;             // 由本线程负责创建子节点
+        bool proven;             // 叶节点结果已证明 (选择时读出)
+        int8_t outcome;          // 已证明时的结果 (叶节点 playerMoved 视角)
+        GameStatus terminal;     // 叶节点为终局时的结果，否则为 PLAYING
+        vector<Point> childMoves;
+        vector<float> priors;
+        double result;           // 黑方视角
+        future<EvalResult> pending;
+    };
+
+    // 根节点顺序减半的进度 (持树锁访问)：预算按模拟次数 (有 playoutLimit 时) 或时间均分到各轮
+    struct RootHalving {
+        vector<uint32_t> candidates;  // 仍在比较的根着法
+        int round = 0, rounds = 0;
+        int descents = 0;             // 已从根下降的次数
+        chrono::high_resolution_clock::time_point start, deadline;
+    };
+
+    const PolicyValueNet* net; // 为空时用随机模拟评估叶节点
+    MCTSConfig config;
+    RootHalving halving;
+    unique_ptr<BatchEvaluator> batcher;
+    FastRandom seeder;
+    MCTSTree tree;
+    uint32_t root = 0;         // 本次搜索的根节点下标
+    SharedTable* table = nullptr;
+    mutex treeMutex;
+    // 树的复用：每次搜索结束后由后台线程把所选着法的子树压缩进 kept，其余分支随旧数组一并清空，
+    // 不占用出着前的时间；下一次搜索开始时等它完成，再在 kept 中找到与新局面对应的节点作为根
+    MCTSTree kept;
+    unique_ptr<Board> keptBoard;  // kept 根节点的局面 (所选着法走完之后)
+    unique_ptr<Rule> keptRule;
+    thread reclaimer;
+    atomic<int> iterationCount;
+    atomic<bool> rootProven;     // 根节点已证明，各线程停止搜索
+    vector<LocalFight> fights;   // 根局面的局部死活急所，根扩展后并入其子节点
+    // 本次搜索所有线程合并后的归属统计
+    vector<long long> ownershipSum;
+    long long ownershipSamples = 0;
+    double marginSum = 0;
+
+    // 急所作为先验知识：相当于该着法已有 fightVisits 次模拟且全胜
+    void applyLocalFights() {
+        for (uint32_t c = tree.firstChild[root]; c < tree.childEnd(root); ++c)
+            for (const LocalFight& f : fights)
+                if (tree.move[c] == f.move) {
+                    tree.prior[c] = max(tree.prior[c], config.fightPrior);
+                    tree.visits[c] += config.fightVisits;
+                    tree.wins[c] += (float)config.fightVisits;
+                }
+        fights.clear();
+    }
+
+    // 复用子树得到的根原是深层节点：无网络的 UCT 只给根算先验，它的子节点先验全为 0。
+    // 顺序减半要按先验挑选候选，在此补上与新扩展的根相同的启发式先验
+    void refillRootPriors(Rule& rule, const Board& board, PieceType color) {
+        if (net || config.usePUCT || !config.rootHalving || !tree.expanded(root)) return;
+        uint32_t first = tree.firstChild[root], end = tree.childEnd(root);
+        vector<Point> moves;
+        for (uint32_t c = first; c < end; ++c) moves.push_back(tree.move[c]);
+        vector<float> priors;
+        heuristicPriors(rule, board, color, moves, priors);
+        for (uint32_t c = first; c < end; ++c) tree.prior[c] = priors[c - first];
+    }
+
+    uint32_t select(uint32_t node) {
+        return config.usePUCT ? tree.bestChildPUCT(node, config.cPuct) : tree.bestChild(node, config.cUct);
+    }
+
+    // 本轮预算是否已用完
+    bool halvingRoundOver() const {
+        double share = (double)(halving.round + 1) / halving.rounds;
+        if (config.playoutLimit > 0) return halving.descents >= share * config.playoutLimit;
+        return chrono::high_resolution_clock::now() >= halving.start + (halving.deadline - halving.start) * share;
+    }
+
+    // 根节点的顺序减半：首次到达已扩展的根时按先验选出候选，之后轮流给访问最少的候选，
+    // 每轮结束保留平均价值较好的一半；候选都已证明不可能更好时交回 UCT/PUCT
+    uint32_t selectRoot() {
+        if (halving.rounds == 0) {
+            vector<uint32_t> all;
+            for (uint32_t c = tree.firstChild[root]; c < tree.childEnd(root); ++c) all.push_back(c);
+            size_t width = min(all.size(), (size_t)max(2, config.halvingWidth));
+            // 根的先验未算过 (全为 0) 时按已有的访问次数挑选，不让子节点的随机顺序决定候选
+            bool hasPriors = any_of(all.begin(), all.end(), [&](uint32_t c) { return tree.prior[c] > 0; });
+            partial_sort(all.begin(), all.begin() + width, all.end(), [&](uint32_t a, uint32_t b) {
+                return hasPriors ? tree.prior[a] > tree.prior[b] : tree.visits[a] > tree.visits[b];
+            });
+            halving.candidates.assign(all.begin(), all.begin() + width);
+            halving.rounds = max(1, (int)ceil(log2((double)width)));
+        }
+        halving.descents++;
+        while (halving.candidates.size() > 1 && halving.round < halving.rounds - 1 && halvingRoundOver()) {
+            sort(halving.candidates.begin(), halving.candidates.end(),
+                 [&](uint32_t a, uint32_t b) { return tree.mean(a) > tree.mean(b); });
+            halving.candidates.resize((halving.candidates.size() + 1) / 2);
+            halving.round++;
+        }
+        uint32_t best = MCTSTree::NONE;
+        for (uint32_t c : halving.candidates)
+            if (!tree.prunable(root, c) && (best == MCTSTree::NONE || tree.visits[c] < tree.visits[best])) best = c;
+        return best != MCTSTree::NONE ? best : select(root);
+    }
+
+    // 无网络时的启发式先验：对 moveHeuristic 做 softmax
+    static void heuristicPriors(Rule& rule, const Board& board, PieceType player,
+                                const vector<Point>& childMoves, vector<float>& priors) {
+        priors.resize(childMoves.size());
+        float maxScore = -std::numeric_limits<float>::infinity();
+        for (size_t k = 0; k < childMoves.size(); ++k) {
+            const Point& m = childMoves[k];
+            priors[k] = (m.x < 0) ? 0.0f : moveHeuristic(rule, board, m.x, m.y, player);
+            maxScore = max(maxScore, priors[k]);
+        }
+        float total = 0;
+        for (auto& pr : priors) { pr = expf(pr - maxScore); total += pr; }
+        for (auto& pr : priors) pr /= total;
+    }
+
+    // 终局结果：1.0 为黑胜，0.0 为白胜
+    static double statusResult(GameStatus status) {
+        if(status == BLACK_WIN) return 1.0; 
+        if(status == WHITE_WIN) return 0.0;
+        return 0.5;
+    }
+
+    // 已证明结果 (playerMoved 视角 -1/0/+1) 与黑方视角结果的换算
+    static double provenResult(int8_t outcome, PieceType playerMoved) {
+        double v = 0.5 + 0.5 * outcome;
+        return playerMoved == BLACK ? v : 1.0 - v;
+    }
+    static int8_t outcomeFromStatus(GameStatus status, PieceType playerMoved) {
+        if (status == DRAW) return 0;
+        return (status == BLACK_WIN) == (playerMoved == BLACK) ? 1 : -1;
+    }
+
+    // 随机模拟到终局 (或深度上限)，返回黑方视角的结果；顺带累计模拟终局的归属。
+    // 中途局面已定或到达 evalDepth 时提前结束，直接返回判定结果或静态评估的胜率。
+    // line 为根之后的树内路径 (根局面由 color 先走)，应手表连同它一起学习
+    double rollout(Worker& w, Rule& simRule, const Board& simBoard, PieceType simPlayer,
+                   const vector<Point>& line, PieceType color) {
+        double cutValue = -1;
+        Point last = line.empty() ? Point{-1, -1} : line.back();
+        if (config.earlyCutoff) rolloutCutoffBegin(simRule, simBoard, w.cutoff);
+        ReplyTable* replies = w.lastGoodReply ? &w.replies : nullptr;
+        if (replies) replies->begin(line, color);
+        bool evalCut = false;
+        PieceType evalToMove = simPlayer;
+        randomPlayout(w.rng, w.moves, simRule, simBoard, simPlayer, config.rolloutDepth, last, replies,
+                      [&](int depth, PieceType toMove, Point prev) {
+            if (config.earlyCutoff) cutValue = rolloutDecided(simRule, simBoard, toMove, prev, w.cutoff);
+            if (cutValue < 0 && config.evalDepth > 0 && depth >= config.evalDepth) {
+                evalCut = true;
+                evalToMove = toMove;
+            }
+            return cutValue >= 0 || evalCut;
+        });
+
+        // 模拟结束处的归属只算一次：归属统计、围棋的静态评估与数子胜负都取自它
+        float margin = 0;
+        bool owned = rolloutOwnership(simRule, w.owner, margin);
+        if (owned) {
+            if (w.ownershipSum.empty()) w.ownershipSum.assign(w.owner.size(), 0);
+            for (size_t i = 0; i < w.owner.size(); ++i) w.ownershipSum[i] += w.owner[i];
+            w.ownershipSamples++;
+            w.marginSum += margin;
+        }
+        if (evalCut) {
+            w.cutoff.margin = margin;
+            cutValue = rolloutStaticValue(simRule, simBoard, evalToMove, w.cutoff);
+        }
+        double result = cutValue;
+        if (result < 0) {
+            GameStatus status = simRule.status();
+            // 如果没分出胜负(深度耗尽)，强制计算分数
+            if(status == PLAYING) {
+               float lead = margin;
+               if (!owned) {
+                   float bScore, wScore;
+                   simRule.calculateScore(bScore, wScore);
+                   lead = bScore - wScore;
+               }
+               if(lead > 0) status = BLACK_WIN;
+               else if(lead < 0) status = WHITE_WIN;
+               else status = DRAW;
+            }
+            result = statusResult(status);
+        }
+        if (replies) replies->learn(result);
+        return result;
+    }
+
+    // --- 1. Selection (选择)：持树锁下降，沿途计入虚拟损失 ---
+    void descend(LeafJob& job) {
+        lock_guard<mutex> lock(treeMutex);
+        job.path.clear();
+        job.line.clear();
+        uint32_t node = root;
+        tree.visits[node] += config.virtualLoss;
+        job.path.push_back(node);
+        // 只要节点已扩展且有子节点，就根据 UCT/PUCT 向下深入；已证明的子树不再展开
+        while(!tree.proven(node) && tree.expanded(node) && tree.childCount[node] > 0) {
+            uint32_t next = (config.rootHalving && node == root) ? selectRoot() : select(node);
+            if (next == MCTSTree::NONE) break;
+            node = next;
+            tree.visits[node] += config.virtualLoss;
+            job.path.push_back(node);
+            job.line.push_back(tree.move[node]);
+        }
+        job.leafMover = (PieceType)tree.playerMoved[node];
+        job.proven = tree.proven(node);
+        job.outcome = tree.pess[node];
+        job.terminal = PLAYING;
+        job.expand = !job.proven && tree.flags[node] == 0;
+        if (job.expand) tree.flags[node] = MCTSTree::EXPANDING;
+    }
+
+    // --- 2/3. 在模拟棋盘上重放路径，准备扩展并评估叶节点 (不持锁) ---
+    // 有批量队列时只提交请求，结果稍后由 finish 取回
+    void evaluate(Worker& w, LeafJob& job, const Board& rootBoard, const Rule& rootRule, PieceType color) {
+        job.childMoves.clear();
+        job.priors.clear();
+        if (job.proven) {
+            job.result = provenResult(job.outcome, job.leafMover);
+            return;
+        }
+        Board simBoard(rootBoard);
+        Rule simRule(rootRule);
+        simRule.setBoard(&simBoard);
+        PieceType simPlayer = color; // 从当前 AI 开始模拟
+        for (const Point& m : job.line) {
+            simRule.makeMove(m.x, m.y, simPlayer);
+            simPlayer = getOpponent(simPlayer);
+        }
+        job.player = simPlayer;
+        if (simRule.isTerminal()) {
+            job.terminal = simRule.status();
+            job.result = statusResult(job.terminal);
+            return;
+        }
+
+        // 扩展：一次性列出全部子节点 (无合法着法但未终局时只有一个虚着子节点)
+        if (job.expand) {
+            collectMoves(simRule, simBoard.getSize(), simPlayer, job.childMoves);
+            if (job.childMoves.empty() && simRule.supportsPass()) job.childMoves.push_back({-1, -1});
+            if (!config.usePUCT) {
+                for (size_t k = job.childMoves.size(); k > 1; --k)
+                    swap(job.childMoves[k - 1], job.childMoves[w.rng.below((int)k)]);
+            }
+        }
+
+        // 有网络时先验与估值来自同一次前向计算
+        if (net) {
+            if (batcher) {
+                job.pending = batcher->submit(simBoard, simPlayer, job.childMoves);
+                return;
+            }
+            double v = net->evaluate(simBoard, simPlayer, job.childMoves, job.priors);
+            job.result = simPlayer == BLACK ? v : 1.0 - v;
+            return;
+        }
+        // 根节点的顺序减半按先验挑选候选，UCT 下也为根计算启发式先验
+        bool rootPriors = config.rootHalving && job.path.size() == 1;
+        if ((config.usePUCT || rootPriors) && job.expand)
+            heuristicPriors(simRule, simBoard, simPlayer, job.childMoves, job.priors);
+        // 共享置换表中有足够可靠的估值 (其他对局或进程搜过这个局面) 时代替随机模拟
+        if (table) {
+            SharedTable::Entry e;
+            uint64_t key = SharedTable::positionKey(simBoard, ruleGameType(simRule), simPlayer);
+            if (table->probe(key, SharedTable::MCTS_VALUE, e) && e.visits >= config.sharedMinVisits) {
+                job.result = simPlayer == BLACK ? e.value : 1.0 - e.value;
+                return;
+            }
+        }
+        // 无网络时从该局面随机模拟
+        job.result = rollout(w, simRule, simBoard, simPlayer, job.line, color);
+    }
+
+    // --- 4. 创建子节点并反向传播 (持锁)，同时撤销虚拟损失 ---
+    void finish(LeafJob& job) {
+        if (job.pending.valid()) {
+            EvalResult r = job.pending.get();
+            job.priors = std::move(r.priors);
+            job.result = job.player == BLACK ? r.value : 1.0 - r.value;
+        }
+        lock_guard<mutex> lock(treeMutex);
+        uint32_t leaf = job.path.back();
+        if (job.expand) {
+            tree.expand(leaf, job.childMoves, job.priors, job.player);
+            if (leaf == root && !fights.empty()) applyLocalFights();
+        }
+        // 终局叶节点得到精确结果，沿路径向上做极小极大传播，直到某层的界不再变化
+        if (job.terminal != PLAYING && !tree.proven(leaf)) {
+            tree.prove(leaf, outcomeFromStatus(job.terminal, job.leafMover));
+            for (size_t i = job.path.size() - 1; i-- > 0;)
+                if (!tree.updateBounds(job.path[i])) break;
+            if (tree.proven(root)) rootProven = true;
+        }
+        float result = (float)job.result;
+        for (uint32_t node : job.path) {
+            tree.visits[node] += 1 - config.virtualLoss;
+            // MCTS 的关键：站在节点代表的棋手视角看胜负
+            // 如果 playerMoved 是 BLACK，它希望结果是 1.0
+            if(tree.playerMoved[node] == BLACK) tree.wins[node] += result;
+            else tree.wins[node] += (1.0f - result); // 如果是 WHITE，它希望结果是 0.0
+        }
+    }
+
+    // 单个搜索线程：有批量队列时同时保持多个在途叶节点，等待结果期间继续选择其他分支
+    void workerLoop(uint64_t seed, const Board& rootBoard, const Rule& rootRule,
+                    PieceType color, chrono::high_resolution_clock::time_point deadline) {
+        Worker w(seed);
+        int n = rootBoard.getSize();
+        double mercy = config.mercyFraction < 0 ? defaultMercyFraction(rootRule) : config.mercyFraction;
+        w.cutoff.mercyMargin = (int)ceil(mercy * n * n);
+        w.cutoff.weights = rolloutEvalWeights(rootRule, n);
+        w.lastGoodReply = config.lastGoodReply < 0 ? defaultLastGoodReply(rootRule) : config.lastGoodReply > 0;
+        if (w.lastGoodReply) w.replies.reset(n);
+        int maxInFlight = batcher ? max(1, (config.batchSize + config.threads - 1) / config.threads) : 1;
+        deque<LeafJob> inFlight;
+        while(chrono::high_resolution_clock::now() < deadline && !rootProven &&
+              (config.playoutLimit <= 0 || iterationCount < config.playoutLimit)) {
+            // 先取回已完成的评估
+            while(!inFlight.empty() && inFlight.front().pending.valid() &&
+                  inFlight.front().pending.wait_for(chrono::seconds(0)) == future_status::ready) {
+                finish(inFlight.front());
+                inFlight.pop_front();
+            }
+            if ((int)inFlight.size() >= maxInFlight) {
+                finish(inFlight.front());
+                inFlight.pop_front();
+                continue;
+            }
+            inFlight.emplace_back();
+            LeafJob& job = inFlight.back();
+            descend(job);
+            evaluate(w, job, rootBoard, rootRule, color);
+            iterationCount++;
+            if (!job.pending.valid()) {
+                finish(job);
+                inFlight.pop_back();
+            }
+        }
+        for (auto& job : inFlight) finish(job);
+
+        if (w.ownershipSamples > 0) {
+            lock_guard<mutex> lock(treeMutex);
+            if (ownershipSum.empty()) ownershipSum.assign(w.ownershipSum.size(), 0);
+            for (size_t i = 0; i < w.ownershipSum.size(); ++i) ownershipSum[i] += w.ownershipSum[i];
+            ownershipSamples += w.ownershipSamples;
+            marginSum += w.marginSum;
+        }
+    }
+
+    // 在上次保留的子树中找与当前局面对应的节点：kept 的根本身 (同一引擎接着替对方走)，
+    // 或根的某个子节点 (对方已应了一手)。对方的应手由新落下的棋子推出，再重放一次核对哈希
+    uint32_t findReusedRoot(const Board& board, PieceType color) {
+        if (!keptBoard || kept.size() == 0) return MCTSTree::NONE;
+        PieceType keptMover = (PieceType)kept.playerMoved[0];
+        if (keptMover != color) {
+            bool same = board.getHash() == keptBoard->getHash();
+            return same ? 0 : MCTSTree::NONE;
+        }
+        if (!kept.expanded(0)) return MCTSTree::NONE;
+        int n = board.getSize();
+        Point reply = {-1, -1};
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                if (keptBoard->getPiece(i, j) == EMPTY && board.getPiece(i, j) != EMPTY) {
+                    if (reply.x >= 0) return MCTSTree::NONE; // 不止一手之差
+                    reply = {i, j};
+                }
+        for (uint32_t c = kept.firstChild[0]; c < kept.childEnd(0); ++c) {
+            if (kept.move[c].x != reply.x || kept.move[c].y != reply.y) continue;
+            Board next(*keptBoard);
+            Rule nextRule(*keptRule);
+            nextRule.setBoard(&next);
+            nextRule.makeMove(reply.x, reply.y, getOpponent(color));
+            return next.getHash() == board.getHash() ? c : MCTSTree::NONE;
+        }
+        return MCTSTree::NONE;
+    }
+
+    // 搜索结束：把根及访问足够多的子节点的估值 (行棋方胜率) 写入共享置换表
+    void publish(const Board& rootBoard, const Rule& rootRule, PieceType color) {
+        GameType type = ruleGameType(rootRule);
+        auto store = [&](const Board& b, PieceType toMove, double value, int visits) {
+            SharedTable::Entry e;
+            e.kind = SharedTable::MCTS_VALUE;
+            e.value = (float)value;
+            e.visits = visits;
+            e.weight = (int)log2((double)max(1, visits));
+            table->store(SharedTable::positionKey(b, type, toMove), e);
+        };
+        if (tree.visits[root] >= config.sharedMinVisits) store(rootBoard, color, stats.rootValue, tree.visits[root]);
+        if (!tree.expanded(root)) return;
+        for (uint32_t c = tree.firstChild[root]; c < tree.childEnd(root); ++c) {
+            if (tree.visits[c] < config.sharedMinVisits && !tree.proven(c)) continue;
+            Board next(rootBoard);
+            Rule nextRule(rootRule);
+            nextRule.setBoard(&next);
+            nextRule.makeMove(tree.move[c].x, tree.move[c].y, color);
+            // 子节点的统计以 color 为视角，换成对方 (轮到走的一方) 的胜率
+            double v = tree.proven(c) ? 0.5 + 0.5 * tree.pess[c] : tree.mean(c);
+            store(next, getOpponent(color), 1.0 - v, max(tree.visits[c], config.sharedMinVisits));
+        }
+    }
+
+    // 出着之后：记下所选着法走完的局面，后台线程把它的子树压缩进 kept 并清空旧树
+    void keepSubtree(uint32_t best, const Board& rootBoard, const Rule& rootRule, PieceType color) {
+        keptBoard = make_unique<Board>(rootBoard);
+        keptRule = make_unique<Rule>(rootRule);
+        keptRule->setBoard(keptBoard.get());
+        Point m = tree.move[best];
+        keptRule->makeMove(m.x, m.y, color);
+        reclaimer = thread([this, best] {
+            tree.extractSubtree(best, kept);
+            tree.clear();
+        });
+    }
+
+public:
+    explicit MCTSEngine(const PolicyValueNet* n = nullptr, MCTSConfig cfg = MCTSConfig())
+        : net(n), config(cfg),
+          seeder((uint64_t)chrono::steady_clock::now().time_since_epoch().count() ^ (uint64_t)(uintptr_t)this),
+          iterationCount(0), rootProven(false) {
+        config.threads = max(1, config.threads);
+        if (net && config.threads > 1)
+            batcher = make_unique<BatchEvaluator>(net, config.batchSize, config.batchWaitUs);
+    }
+    ~MCTSEngine() {
+        if (reclaimer.joinable()) reclaimer.join();
+    }
+
+    // Level 3: MCTS AI 实现
+    Point search(const Board& realBoard, const GameRule& realRule, PieceType color) override {
+        // 设定思考时间限制 (例如 2 秒)，从进入搜索起计时，所有线程共享同一棵树
+        auto deadline = chrono::high_resolution_clock::now() + chrono::milliseconds(config.timeLimitMs);
+        // 1. 复制当前局面，避免破坏真实棋盘
+        Board rootBoard(realBoard);
+        Rule rootRule(static_cast<const Rule&>(realRule));
+        rootRule.setBoard(&rootBoard);
+        
+        // 根节点：上一手是对手下的，现在轮到我 (color) 下。能复用上次保留的子树时从它继续，
+        // 否则从一个空的根开始 (两份数组交替使用，保留已分配的容量)
+        if (reclaimer.joinable()) reclaimer.join();
+        root = config.reuseTree ? findReusedRoot(rootBoard, color) : MCTSTree::NONE;
+        swap(tree, kept);
+        kept.clear();
+        keptBoard.reset();
+        keptRule.reset();
+        if (root == MCTSTree::NONE) {
+            tree.clear();
+            root = tree.add({-1, -1}, getOpponent(color), 0.0f);
+        } else {
+            refillRootPriors(rootRule, rootBoard, color);
+        }
+        table = config.useSharedTable ? sharedTable() : nullptr;
+        if (table) table->newSearch();
+        fights.clear();
+        if (config.fightNodes > 0) fights = rootLocalFights(rootRule, rootBoard, color, config.fightNodes);
+        if (tree.expanded(root) && !fights.empty()) applyLocalFights();
+        
+        iterationCount = 0;
+        // 复用的子树可能已经证明了根 (上一手已找到必胜)，此时不必再搜索，直接按已证明的结果出着
+        rootProven = tree.proven(root);
+        ownershipSum.clear();
+        ownershipSamples = 0;
+        marginSum = 0;
+        halving = RootHalving();
+        halving.start = chrono::high_resolution_clock::now();
+        halving.deadline = deadline;
+        uint64_t seed = (uint64_t)seeder.next() << 32 | seeder.next();
+        vector<thread> helpers;
+        for (int t = 1; t < config.threads; ++t)
+            helpers.emplace_back([&, t] { workerLoop(seed + t, rootBoard, rootRule, color, deadline); });
+        workerLoop(seed, rootBoard, rootRule, color, deadline);
+        for (auto& th : helpers) th.join();
+        
+        // 最终决策：在能保证已知最好结果、或仍有机会超过它的着法中选访问次数最多的 (最稳健)；
+        // 有已证明的胜着时只在胜着中选
+        Point bestMove = {-1, -1};
+        int maxVisits = -1;
+        stats.moves.clear();
+        stats.visits.clear();
+        stats.lower.clear();
+        stats.upper.clear();
+        stats.rootValue = 0.5;
+        int8_t guaranteed = -1;
+        uint32_t first = tree.firstChild[root], end = tree.expanded(root) ? tree.childEnd(root) : first;
+        for (uint32_t c = first; c < end; ++c) guaranteed = max(guaranteed, tree.pess[c]);
+        // 要么已保证该结果，要么还有机会超过它
+        auto eligible = [&](uint32_t c) { return tree.pess[c] == guaranteed || tree.opti[c] > guaranteed; };
+        uint32_t best = MCTSTree::NONE;
+        for (uint32_t c = first; c < end; ++c) {
+            stats.moves.push_back(tree.move[c]);
+            stats.visits.push_back(tree.visits[c]);
+            stats.lower.push_back(tree.pess[c]);
+            stats.upper.push_back(tree.opti[c]);
+            if(eligible(c) && tree.visits[c] > maxVisits) {
+                maxVisits = tree.visits[c];
+                best = c;
+            }
+        }
+        // 顺序减半：在最后一轮的候选中取平均价值最高的 (各候选访问次数相近，不能按次数比)；
+        // 访问次数不到最多者一半的候选均值不可靠，不用它替换访问最多的着法
+        uint32_t survivor = MCTSTree::NONE;
+        for (uint32_t c : halving.candidates)
+            if (eligible(c) && 2 * tree.visits[c] >= maxVisits &&
+                (survivor == MCTSTree::NONE || tree.mean(c) > tree.mean(survivor))) survivor = c;
+        if (survivor != MCTSTree::NONE) best = survivor;
+        if (best != MCTSTree::NONE) {
+            bestMove = tree.move[best];
+            if (tree.proven(best)) stats.rootValue = 0.5 + 0.5 * tree.pess[best];
+            else if (tree.visits[best] > 0) stats.rootValue = tree.mean(best);
+        }
+        
+        stats.ownership.clear();
+        stats.expectedScore = 0;
+        if (ownershipSamples > 0) {
+            for (long long v : ownershipSum) stats.ownership.push_back((float)((double)v / ownershipSamples));
+            stats.expectedScore = marginSum / ownershipSamples;
+        }
+        stats.iterations = iterationCount;
+        if (table) publish(rootBoard, rootRule, color);
+        if (config.reuseTree && best != MCTSTree::NONE) keepSubtree(best, rootBoard, rootRule, color);
+        else tree.clear();
+        return bestMove;
+    }
+};
+
+// --- NUMA 拓扑：从 sysfs 读出各节点的 CPU 列表；非 Linux 或读不到时视为单节点 ---
+// cpulist 格式形如 "0-7,16-23"
+static vector<int> parseCpuList(const string& text) {
+    vector<int> cpus;
+    stringstream ss(text);
+    string part;
+    while (getline(ss, part, ',')) {
+        int lo, hi;
+        if (sscanf(part.c_str(), "%d-%d", &lo, &hi) == 2) {
+            for (int c = lo; c <= hi; ++c) cpus.push_back(c);
+        } else if (sscanf(part.c_str(), "%d", &lo) == 1) {
+            cpus.push_back(lo);
+        }
+    }
+    return cpus;
+}
+
+vector<vector<int>> numaNodeCpus() {
+    vector<vector<int>> nodes;
+#ifdef __linux__
+    for (int node = 0; ; ++node) {
+        ifstream in("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+        if (!in.is_open()) break;
+        string text;
+        getline(in, text);
+        vector<int> cpus = parseCpuList(text);
+        if (!cpus.empty()) nodes.push_back(std::move(cpus));
+    }
+#endif
+    return nodes;
+}
+
+// 把调用线程绑定到给定 CPU 上；之后由它创建的线程继承同样的绑定
+bool pinCurrentThread(const vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus)
+        if (c >= 0 && c < CPU_SETSIZE) CPU_SET(c, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+// --- 多 NUMA 节点的根并行 MCTS：每个节点一个引擎 (各自的树与线程)，每手结束时在根合并 ---
+// 每个节点的搜索线程先绑到本节点的 CPU 再开始搜索，它创建的工作线程继承绑定；
+// 树的数组由本节点的线程首次写入，页面随之分配在本节点，搜索中不再访问远端内存。
+// 合并按着法累加各树根节点的访问次数，取最多者；某棵树已证明必胜时直接采用它的着法
+template<class Rule>
+class NumaMCTSEngine : public SearchEngine {
+private:
+    vector<vector<int>> nodes;
+    vector<unique_ptr<MCTSEngine<Rule>>> engines;
+
+public:
+    NumaMCTSEngine(const PolicyValueNet* net, MCTSConfig config, vector<vector<int>> nodeCpus)
+        : nodes(std::move(nodeCpus)) {
+        // 线程数按各节点的 CPU 数分摊，每个节点至少一个
+        size_t totalCpus = 0;
+        for (auto& cpus : nodes) totalCpus += cpus.size();
+        int total = max(1, config.threads);
+        for (auto& cpus : nodes) {
+            MCTSConfig c = config;
+            c.threads = max(1, (int)(total * cpus.size() / max<size_t>(1, totalCpus)));
+            engines.push_back(make_unique<MCTSEngine<Rule>>(net, c));
+        }
+    }
+
+    Point search(const Board& board, const GameRule& rule, PieceType player) override {
+        vector<Point> moves(engines.size());
+        vector<thread> groups;
+        for (size_t i = 0; i < engines.size(); ++i)
+            groups.emplace_back([&, i] {
+                pinCurrentThread(nodes[i]);
+                moves[i] = engines[i]->search(board, rule, player);
+            });
+        for (auto& th : groups) th.join();
+
+        stats = SearchStats();
+        // 各着法：访问次数求和；已证明的界对每棵树都成立，取最紧的 (下界取大、上界取小)
+        struct Merged {
+            int visits = 0;
+            int8_t lower = -1, upper = 1;
+        };
+        map<pair<int, int>, Merged> merged;
+        int weight = 0;
+        for (size_t i = 0; i < engines.size(); ++i) {
+            const SearchStats& s = engines[i]->lastStats();
+            stats.iterations += s.iterations;
+            for (size_t k = 0; k < s.moves.size(); ++k) {
+                Merged& m = merged[{s.moves[k].x, s.moves[k].y}];
+                m.visits += s.visits[k];
+                m.lower = max(m.lower, s.lower[k]);
+                m.upper = min(m.upper, s.upper[k]);
+            }
+            // 归属与目数按迭代次数加权平均
+            if (!s.ownership.empty()) {
+                if (stats.ownership.empty()) stats.ownership.assign(s.ownership.size(), 0.0f);
+                for (size_t k = 0; k < s.ownership.size(); ++k) stats.ownership[k] += s.ownership[k] * s.iterations;
+                stats.expectedScore += s.expectedScore * s.iterations;
+                weight += s.iterations;
+            }
+        }
+        if (weight > 0) {
+            for (auto& o : stats.ownership) o /= weight;
+            stats.expectedScore /= weight;
+        }
+        int8_t guaranteed = -1;
+        for (auto& kv : merged) {
+            stats.moves.push_back({kv.first.first, kv.first.second});
+            stats.visits.push_back(kv.second.visits);
+            stats.lower.push_back(kv.second.lower);
+            stats.upper.push_back(kv.second.upper);
+            guaranteed = max(guaranteed, kv.second.lower);
+        }
+
+        // 与单棵树的最终决策相同：只在能保证已知最好结果、或仍有机会超过它的着法中比较访问次数，
+        // 所以任何一棵树证明必胜的着法优先，任何一棵树证明必败的着法不选
+        Point best = {-1, -1};
+        int bestVisits = -1;
+        size_t bestIndex = 0;
+        for (size_t k = 0; k < stats.moves.size(); ++k) {
+            bool eligible = stats.lower[k] == guaranteed || stats.upper[k] > guaranteed;
+            if (eligible && stats.visits[k] > bestVisits) {
+                bestVisits = stats.visits[k];
+                best = stats.moves[k];
+                bestIndex = k;
+            }
+        }
+        if (bestVisits >= 0 && stats.lower[bestIndex] == stats.upper[bestIndex]) {
+            stats.rootValue = 0.5 + 0.5 * stats.lower[bestIndex];
+            return best;
+        }
+        // 胜率取选了同一着法的各树的平均 (没有则取全部的平均)
+        double sum = 0, all = 0;
+        int count = 0;
+        for (size_t i = 0; i < engines.size(); ++i) {
+            all += engines[i]->lastStats().rootValue;
+            if (moves[i].x == best.x && moves[i].y == best.y) {
+                sum += engines[i]->lastStats().rootValue;
+                count++;
+            }
+        }
+        stats.rootValue = count > 0 ? sum / count : all / engines.size();
+        if (bestVisits < 0) best = moves[0];
+        return best;
+    }
+};
+
+// --- Alpha-beta 搜索 (黑白棋 / 五子棋)：迭代加深 + NNUE 增量评估 ---
+// 所有着法都在同一块棋盘上 make / unmake：改动记入棋盘日志，撤销时按日志回滚，
+// NNUE 累加器随之压栈 / 弹栈，整个搜索过程不复制棋盘
+struct AlphaBetaConfig {
+    int timeLimitMs = 2000;
+    int maxDepth = 32;
+    bool useSharedTable = true; // 已挂接共享置换表时读写它
+};
+
+// 候选着法过滤：五子棋只考虑已有棋子附近的点，其余规则考虑全部合法着法
+template<class Rule>
+bool isSearchCandidate(const Rule&, const Board&, int, int) { return true; }
+bool isSearchCandidate(const GomokuRule&, const Board& board, int x, int y) {
+    return neighbourhoodScore(board, x, y) > 0;
+}
+
+// 没有训练好的 NNUE 权值时，五子棋叶节点改用增量维护的棋形分 (逐格权值构造的线性评估不认识活三、冲四)；
+// 其余规则沿用线性评估
+template<class Rule>
+bool shapeFallback(const Rule&) { return false; }
+bool shapeFallback(const GomokuRule&) { return true; }
+
+template<class Rule>
+class AlphaBetaEngine : public SearchEngine {
+private:
+    static const int WIN_SCORE = 1000000;
+    // 子树内没有静态评估 (每条线都走到终局) 的结果是精确值，置换表中以此权重存放，对任何深度都有效
+    static const int PROVEN_WEIGHT = 255;
+
+    struct Undo {
+        size_t mark;
+        GameStatus status;
+        int passes;
+    };
+
+    GameType type;
+    AlphaBetaConfig config;
+    Board* board = nullptr;
+    Rule* rule = nullptr;
+    vector<BoardChange> journal;
+    NnueEvaluator nnue;
+    GomokuShapeTracker shapes;
+    vector<vector<pair<float, Point>>> ordered; // 每层的候选着法 (启发分, 着法)，按层预分配
+    chrono::steady_clock::time_point deadline;
+    bool timeUp = false;
+    long long nodes = 0;
+    SharedTable* table = nullptr;
+    bool useShapes = false; // 叶节点用 shapes 而不是 nnue
+    bool inexact = false; // 当前子树用到了静态评估 (或来历不明的置换表结果)
+
+    // 叶节点评估 (行棋方视角)
+    int evaluate(PieceType player) {
+        inexact = true;
+        if (useShapes) {
+            double shape = shapes.score(player) * (EVAL_WIN_SCALE / GOMOKU_SHAPE_SCALE);
+            return (int)lround(player == BLACK ? shape : -shape);
+        }
+        return nnue.evaluate(player);
+    }
+
+    // 生成 player 的候选着法并按启发分降序排列
+    void generate(PieceType player, int ply) {
+        auto& out = ordered[ply];
+        out.clear();
+        int n = board->getSize();
+        for(int i=0; i<n; ++i)
+            for(int j=0; j<n; ++j)
+                if(rule->isValidMove(i, j, player) && isSearchCandidate(*rule, *board, i, j))
+                    out.push_back({moveHeuristic(*rule, *board, i, j, player), {i, j}});
+        // 空棋盘上没有"附近"的点，直接下天元
+        if (out.empty() && board->countPieces(EMPTY) == n * n && rule->isValidMove(n / 2, n / 2, player))
+            out.push_back({0.0f, {n / 2, n / 2}});
+        stable_sort(out.begin(), out.end(),
+                    [](const pair<float, Point>& a, const pair<float, Point>& b) { return a.first > b.first; });
+    }
+
+    Undo makeMove(Point m, PieceType player) {
+        Undo u{journal.size(), rule->status(), rule->getPassCount()};
+        rule->makeMove(m.x, m.y, player);
+        if (useShapes) shapes.push(*board, journal, u.mark);
+        else nnue.push(journal, u.mark);
+        return u;
+    }
+    void unmakeMove(const Undo& u) {
+        if (useShapes) shapes.pop();
+        else nnue.pop();
+        board->rollback(u.mark);
+        rule->restoreStatus(u.status, u.passes);
+    }
+
+    // 终局分 (player 视角)：越快取胜越好，越晚落败越好
+    int terminalScore(PieceType player, int ply) const {
+        GameStatus s = rule->status();
+        if (s == DRAW) return 0;
+        bool win = (s == BLACK_WIN) == (player == BLACK);
+        return win ? WIN_SCORE - ply : -WIN_SCORE + ply;
+    }
+
+    // 胜负分按"距本节点的步数"存入置换表，取出时换回距根的步数
+    static int toTable(int score, int ply) {
+        if (score >= WIN_SCORE - 1000) return score + ply;
+        if (score <= -WIN_SCORE + 1000) return score - ply;
+        return score;
+    }
+    static int fromTable(int score, int ply) {
+        if (score >= WIN_SCORE - 1000) return score - ply;
+        if (score <= -WIN_SCORE + 1000) return score + ply;
+        return score;
+    }
+
+    int negamax(int depth, int alpha, int beta, PieceType player, int ply) {
+        if ((++nodes & 1023) == 0 && chrono::steady_clock::now() >= deadline) timeUp = true;
+        if (timeUp) return 0;
+        if (rule->isTerminal()) return terminalScore(player, ply);
+        if (depth == 0) return evaluate(player);
+
+        // 置换表：深度足够的表项直接给出结果或收窄窗口，其最佳着法排到最前
+        uint64_t key = 0;
+        int tableMove = -1;
+        if (table) {
+            key = SharedTable::positionKey(*board, type, player);
+            SharedTable::Entry e;
+            if (table->probe(key, SharedTable::EXACT, e)) {
+                tableMove = e.move;
+                if (e.weight >= depth) {
+                    int t = fromTable(e.score, ply);
+                    bool cut = e.kind == SharedTable::EXACT;
+                    if (e.kind == SharedTable::LOWER) alpha = max(alpha, t);
+                    else if (e.kind == SharedTable::UPPER) beta = min(beta, t);
+                    if (cut || alpha >= beta) {
+                        if (e.weight < PROVEN_WEIGHT) inexact = true;
+                        return t;
+                    }
+                }
+            }
+        }
+        int alphaOrig = alpha; // 结果不超过它时只是上界
+        bool outerInexact = inexact;
+        inexact = false;
+
+        generate(player, ply);
+        int n = board->getSize();
+        if (tableMove >= 0) {
+            auto& out = ordered[ply];
+            for (size_t i = 1; i < out.size(); ++i)
+                if (out[i].second.x * n + out[i].second.y == tableMove) {
+                    rotate(out.begin(), out.begin() + i, out.begin() + i + 1);
+                    break;
+                }
+        }
+        if (ordered[ply].empty()) {
+            // 无子可下：黑白棋虚着一手继续搜索，其余规则按静态评估
+            int score;
+            if (!rule->supportsPass()) {
+                score = evaluate(player);
+            } else {
+                Undo u = makeMove({-1, -1}, player);
+                score = -negamax(depth - 1, -beta, -alpha, getOpponent(player), ply + 1);
+                unmakeMove(u);
+            }
+            inexact = inexact || outerInexact;
+            return score;
+        }
+        int best = -WIN_SCORE - 1;
+        Point bestMove = ordered[ply][0].second;
+        for (size_t i = 0; i < ordered[ply].size(); ++i) {
+            Undo u = makeMove(ordered[ply][i].second, player);
+            int score = -negamax(depth - 1, -beta, -alpha, getOpponent(player), ply + 1);
+            unmakeMove(u);
+            if (timeUp) return 0;
+            if (score > best) {
+                best = score;
+                bestMove = ordered[ply][i].second;
+            }
+            if (score > alpha) alpha = score;
+            if (alpha >= beta) break;
+        }
+        if (table) {
+            SharedTable::Entry e;
+            e.kind = best <= alphaOrig ? SharedTable::UPPER : (best >= beta ? SharedTable::LOWER : SharedTable::EXACT);
+            e.score = toTable(best, ply);
+            e.move = bestMove.x * n + bestMove.y;
+            e.weight = inexact ? depth : PROVEN_WEIGHT;
+            table->store(key, e);
+        }
+        inexact = inexact || outerInexact;
+        return best;
+    }
+
+    // 评估分换算为行棋方胜率 (与 MCTS 的 rootValue 同一量纲)
+    static double scoreToValue(int score) {
+        if (score >= WIN_SCORE - 1000) return 1.0;
+        if (score <= -WIN_SCORE + 1000) return 0.0;
+        return 1.0 / (1.0 + exp(-score / EVAL_WIN_SCALE));
+    }
+
+public:
+    AlphaBetaEngine(GameType t, AlphaBetaConfig cfg = AlphaBetaConfig()) : type(t), config(cfg) {}
+
+    Point search(const Board& realBoard, const GameRule& realRule, PieceType color) override {
+        Board rootBoard(realBoard);
+        Rule rootRule(static_cast<const Rule&>(realRule));
+        rootRule.setBoard(&rootBoard);
+        board = &rootBoard;
+        rule = &rootRule;
+        journal.clear();
+        rootBoard.setJournal(&journal);
+        const NnueWeights* weights = loadNnueForGame(type, rootBoard.getSize());
+        useShapes = !weights->trained && shapeFallback(rootRule);
+        if (useShapes) shapes.reset(rootBoard);
+        else nnue.reset(weights, rootBoard);
+        ordered.assign(config.maxDepth + 2, {});
+        deadline = chrono::steady_clock::now() + chrono::milliseconds(config.timeLimitMs);
+        timeUp = false;
+        nodes = 0;
+        table = config.useSharedTable ? sharedTable() : nullptr;
+        if (table) table->newSearch();
+
+        generate(color, 0);
+        vector<pair<float, Point>> rootMoves = ordered[0];
+        stats.moves.clear();
+        stats.visits.clear();
+        stats.rootValue = 0.5;
+        Point best = {-1, -1};
+        if (!rootMoves.empty()) {
+            best = rootMoves[0].second;
+            // 迭代加深：只采用完整搜完的一层的结果，上一层的最佳着法排到最前先搜
+            for (int depth = 1; depth <= config.maxDepth; ++depth) {
+                int alpha = -WIN_SCORE - 1;
+                size_t bestIndex = 0;
+                inexact = false;
+                for (size_t i = 0; i < rootMoves.size(); ++i) {
+                    Undo u = makeMove(rootMoves[i].second, color);
+                    int score = -negamax(depth - 1, -WIN_SCORE - 1, -alpha, getOpponent(color), 1);
+                    unmakeMove(u);
+                    if (timeUp) break;
+                    if (score > alpha) {
+                        alpha = score;
+                        bestIndex = i;
+                    }
+                }
+                if (timeUp) break;
+                best = rootMoves[bestIndex].second;
+                stats.rootValue = scoreToValue(alpha);
+                rotate(rootMoves.begin(), rootMoves.begin() + bestIndex, rootMoves.begin() + bestIndex + 1);
+                if (abs(alpha) >= WIN_SCORE - 1000) break; // 胜负已定
+                if (!inexact) break; // 每条线都走到了终局 (如已证明的和棋)，再加深结果也不会变
+            }
+        }
+        rootBoard.setJournal(nullptr);
+        stats.iterations = (int)min<long long>(nodes, numeric_limits<int>::max());
+        return best;
+    }
+};
+
+// 每局按游戏类型实例化一次具体规则的搜索引擎
+unique_ptr<SearchEngine> createSearchEngine(GameType type, const MCTSConfig& config) {
+    const PolicyValueNet* net = loadNetForGame(type);
+    // 多个 NUMA 节点且多线程时每个节点一棵树
+    vector<vector<int>> nodes = config.numaAware && config.threads > 1 ? numaNodeCpus() : vector<vector<int>>();
+    if (nodes.size() > 1) {
+        if (type == GOMOKU) return make_unique<NumaMCTSEngine<GomokuRule>>(net, config, nodes);
+        if (type == GO) return make_unique<NumaMCTSEngine<GoRule>>(net, config, nodes);
+        return make_unique<NumaMCTSEngine<ReversiRule>>(net, config, nodes);
+    }
+    if (type == GOMOKU) return make_unique<MCTSEngine<GomokuRule>>(net, config);
+    if (type == GO) return make_unique<MCTSEngine<GoRule>>(net, config);
+    return make_unique<MCTSEngine<ReversiRule>>(net, config);
+}
+
+// 对局用的默认配置：无网络时用 moveHeuristic 的启发式先验，同样走 PUCT
+unique_ptr<SearchEngine> createSearchEngine(GameType type) {
+    MCTSConfig config;
+    config.usePUCT = true;
+    config.threads = max(1u, thread::hardware_concurrency());
+    return createSearchEngine(type, config);
+}
+
+// 按 AI 等级选择引擎：Lv4 在黑白棋/五子棋上用 alpha-beta，围棋分支太多仍用 MCTS
+unique_ptr<SearchEngine> createEngineForLevel(GameType type, int level) {
+    if (level == 4 && type == REVERSI) return make_unique<AlphaBetaEngine<ReversiRule>>(type);
+    if (level == 4 && type == GOMOKU) return make_unique<AlphaBetaEngine<GomokuRule>>(type);
+    return createSearchEngine(type);
+}
+
+// --- 对局裁决：无望一方认输、双方估值都接近均势时判和 (机机对战与自对弈共用) ---
+struct AdjudicationConfig {
+    double resignThreshold = 0.05; // 行棋方胜率低于它视为无望
+    int resignMoves = 4;           // 同一方连续这么多手都无望才认输
+    double drawMargin = 0.03;      // 双方胜率都在 0.5 ± drawMargin 内视为均势
+    int drawPlies = 16;            // 连续这么多手 (双方合计) 均势才判和
+    int minPlies = 10;             // 开局这么多手内不裁决
+};
+
+class Adjudicator {
+private:
+    AdjudicationConfig cfg;
+    bool drawAllowed;      // 围棋有贴目，不判和
+    int lowStreak[3] = {0, 0, 0};
+    int drawStreak = 0;
+
+public:
+    Adjudicator(GameType type, const AdjudicationConfig& c = AdjudicationConfig())
+        : cfg(c), drawAllowed(type != GO) {}
+
+    void reset() {
+        lowStreak[BLACK] = lowStreak[WHITE] = 0;
+        drawStreak = 0;
+    }
+
+    // 记录 player 在第 ply 手由搜索得到的行棋方胜率，返回裁决结果 (PLAYING 表示继续)
+    GameStatus record(PieceType player, double value, int ply) {
+        lowStreak[player] = value < cfg.resignThreshold ? lowStreak[player] + 1 : 0;
+        drawStreak = fabs(value - 0.5) <= cfg.drawMargin ? drawStreak + 1 : 0;
+        if (ply < cfg.minPlies) return PLAYING;
+        if (lowStreak[player] >= cfg.resignMoves) return player == BLACK ? WHITE_WIN : BLACK_WIN;
+        if (drawAllowed && drawStreak >= cfg.drawPlies) return DRAW;
+        return PLAYING;
+    }
+};
+
+class AIPlayer : public Player {
+private:
+    int level; 
+    GameType gameType;
+    unique_ptr<SearchEngine> engine;
+    bool searched = false; // 上一手是否来自搜索
+public:
+    AIPlayer(string n, PieceType c, int lvl, GameType type, unique_ptr<SearchEngine> eng)
+        : Player(n, c), level(lvl), gameType(type), engine(std::move(eng)) {}
+
+    bool lastValue(double& value) const override {
+        if (!searched) return false;
+        value = engine->lastStats().rootValue;
+        return true;
+    }
+
+    bool lastOwnership(vector<float>& ownership, double& expectedScore) const override {
+        if (!searched || engine->lastStats().ownership.empty()) return false;
+        ownership = engine->lastStats().ownership;
+        expectedScore = engine->lastStats().expectedScore;
+        return true;
+    }
+    
+    Point getMove(const Board& board, GameRule* rule, GameView* view) override {
+        searched = false;
+        // Lv3 MCTS / Lv4 Alpha-beta 调用 (围棋的局部死活由 MCTS 在根节点求解，作为先验交给搜索)
+        if (level >= 3) {
+             cout << (level == 3 ? "AI (MCTS Lv3) 正在思考..." : "AI (AlphaBeta Lv4) 正在思考...") << endl;
+             Point m = engine->search(board, *rule, color);
+             searched = true;
+             cout << (level == 3 ? "MCTS 模拟次数: " : "搜索节点数: ") << engine->lastStats().iterations << endl;
+             if (m.x == -1) return {-1, -1}; // 无棋可走 Pass
+             return m;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(800));
+        
+        vector<Point> validMoves;
+        for(int i=0; i<board.getSize(); ++i) {
+            for(int j=0; j<board.getSize(); ++j) {
+                if(rule->isValidMove(i, j, color)) validMoves.push_back({i, j});
+            }
+        }
+
+        if (validMoves.empty()) return {-1, -1}; 
+
+        if (level == 1) { // Lv1 Random
+            int idx = rand() % validMoves.size();
+            return validMoves[idx];
+        } else { // Lv2 Greedy
+            // 逐格权值按游戏与棋盘尺寸取 (有调优结果时用调优结果)
+            const vector<float>& weights = loadEvalWeights(gameType, board.getSize());
+            float bestScore = -numeric_limits<float>::infinity();
+            Point bestMove = validMoves[0];
+            
+            for (auto p : validMoves) {
+                float score = weights[p.x * board.getSize() + p.y];
+                score += rand() % 5; 
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestMove = p;
+                }
+            }
+            return bestMove;
+        }
+    }
+};
+
+// ==========================================
+// 6. Controller 层：游戏管理器
+// ==========================================
+
+struct GameState {
+    Board board;
+    PieceType currentPlayer;
+    int passCount;
+    vector<Point> moveHistory;
+};
+
+class GameManager {
+private:
+    unique_ptr<Board> board;
+    unique_ptr<GameRule> rule;
+    unique_ptr<GameView> view;
+    unique_ptr<UserManager> userMgr;
+    
+    unique_ptr<Player> playerBlack;
+    unique_ptr<Player> playerWhite;
+    
+    PieceType currentTurn;
+    GameType gameType;
+    int passCount;
+    // 最近一次搜索在其根局面上的归属统计 (围棋)，终局局面与之相同时用于判定死子
+    OwnershipEstimate searchOwnership;
+    uint64_t searchOwnershipHash = 0;
+    
+    stack<GameState> undoStack;
+    vector<Point> moveHistory;
+
+    void saveState() {
+        GameState state = {*board, currentTurn, passCount, moveHistory};
+        undoStack.push(state);
+    }
+
+    // 辅助函数：根据 AI 等级返回名字
+    string getAIName(int level) {
+        if (level == 1) return "AI-Simple";
+        if (level == 2) return "AI-Greedy";
+        if (level == 3) return "AI-MCTS";
+        if (level == 4) return "AI-AlphaBeta";
+        return "AI";
+    }
+
+    void setupPlayers(int mode, string username) {
+        if (mode == 1) { // PvP: 人人对战
+            playerBlack = make_unique<HumanPlayer>(username, BLACK);
+            playerWhite = make_unique<HumanPlayer>("Player2", WHITE);
+        } 
+        else if (mode == 2) { // PvAI: 人机对战
+            int level = 1;
+            string input = view->getUserInput("选择AI难度 (1:简单, 2:贪心, 3:MCTS, 4:AlphaBeta): ");
+            if (input == "2") level = 2;
+            if (input == "3") level = 3;
+            if (input == "4") level = 4;
+            
+            string side = view->getUserInput("你执黑吗? (y/n): ");
+            if (side == "y") {
+                playerBlack = make_unique<HumanPlayer>(username, BLACK);
+                playerWhite = make_unique<AIPlayer>(getAIName(level) + "(W)", WHITE, level, gameType, createEngineForLevel(gameType, level));
+            } else {
+                playerBlack = make_unique<AIPlayer>(getAIName(level) + "(B)", BLACK, level, gameType, createEngineForLevel(gameType, level));
+                playerWhite = make_unique<HumanPlayer>(username, WHITE);
+            }
+        } 
+        else { // AIvAI: 机机对战
+            // 允许分别设置黑白双方的 AI 难度
+            int levelBlack = 1;
+            string inputB = view->getUserInput("选择黑方AI难度 (1:简单, 2:贪心, 3:MCTS, 4:AlphaBeta): ");
+            if (inputB == "2") levelBlack = 2;
+            if (inputB == "3") levelBlack = 3;
+            if (inputB == "4") levelBlack = 4;
+
+            int levelWhite = 1;
+            string inputW = view->getUserInput("选择白方AI难度 (1:简单, 2:贪心, 3:MCTS, 4:AlphaBeta): ");
+            if (inputW == "2") levelWhite = 2;
+            if (inputW == "3") levelWhite = 3;
+            if (inputW == "4") levelWhite = 4;
+
+            playerBlack = make_unique<AIPlayer>(getAIName(levelBlack) + "(B)", BLACK, levelBlack, gameType, createEngineForLevel(gameType, levelBlack));
+            playerWhite = make_unique<AIPlayer>(getAIName(levelWhite) + "(W)", WHITE, levelWhite, gameType, createEngineForLevel(gameType, levelWhite));
+        }
+    }
+
+public:
+    GameManager() {
+        view = make_unique<ConsoleView>();
+        userMgr = make_unique<UserManager>();
+        srand(time(0));
+    }
+
+    void run() {
+        while (true) {
+            if (!userMgr->isLoggedIn()) {
+                view->showMainMenu();
+                string choice = view->getUserInput("请选择: ");
+                if (choice == "1") {
+                    string u = view->getUserInput("用户名: ");
+                    string p = view->getUserInput("密码: ");
+                    if (userMgr->login(u, p)) cout << "登录成功！" << endl;
+                    else cout << "登录失败。" << endl;
+                } else if (choice == "2") {
+                    string u = view->getUserInput("用户名: ");
+                    string p = view->getUserInput("密码: ");
+                    if (userMgr->registerUser(u, p)) cout << "注册成功，请登录。" << endl;
+                    else cout << "用户已存在。" << endl;
+                } else if (choice == "3") {
+                    cout << "以游客身份进入。" << endl;
+                    break; 
+                } else if (choice == "4") {
+                    return;
+                }
+                if (userMgr->isLoggedIn()) break;
+            } else break;
+        }
+
+        while(true) {
+            cout << "\n欢迎, " << userMgr->getStats(userMgr->getCurrentUsername()) << endl;
+            cout << "1. 开始游戏" << endl;
+            cout << "2. 读取存档/回放" << endl;
+            cout << "3. 退出登录" << endl;
+            string choice = view->getUserInput("请选择: ");
+
+            if (choice == "3") {
+                userMgr->logout();
+                run(); 
+                return;
+            } else if (choice == "1") {
+                cout << "选择游戏: 1.五子棋 2.围棋 3.黑白棋" << endl;
+                string g = view->getUserInput("> ");
+                if (g == "1") gameType = GOMOKU;
+                else if (g == "2") gameType = GO;
+                else gameType = REVERSI;
+
+                int size = boardSizeFor(gameType);
+                
+                cout << "选择模式: 1.人人对战 2.人机对战 3.机机对战" << endl;
+                string m = view->getUserInput("> ");
+                
+                board = make_unique<Board>(size);
+                rule = createRule(gameType, board.get());
+                
+                rule->initBoard();
+                setupPlayers(stoi(m), userMgr->getCurrentUsername());
+                
+                currentTurn = BLACK;
+                passCount = 0;
+                moveHistory.clear();
+                while(!undoStack.empty()) undoStack.pop();
+
+                gameLoop();
+            } else if (choice == "2") {
+                string fname = view->getUserInput("输入文件名: ");
+                if (loadGame(fname)) {
+                    cout << "1. 继续游戏  2. 观看回放" << endl;
+                    if (view->getUserInput("> ") == "2") {
+                        replayMode();
+                    } else {
+                        gameLoop();
+                    }
+                } else {
+                    cout << "读取失败。" << endl;
+                }
+            }
+        }
+    }
+
+    // 宣布胜负并记入真人玩家的战绩
+    void announceResult(GameStatus status, const string& msg) {
+        view->displayBoard(*board, currentTurn, msg);
+        if (status == BLACK_WIN) {
+            cout << "黑方获胜!" << endl;
+            if (!playerBlack->isAI()) userMgr->recordGameResult(true);
+            if (!playerWhite->isAI()) userMgr->recordGameResult(false);
+        } else if (status == WHITE_WIN) {
+            cout << "白方获胜!" << endl;
+            if (!playerWhite->isAI()) userMgr->recordGameResult(true);
+            if (!playerBlack->isAI()) userMgr->recordGameResult(false);
+        } else {
+            cout << "平局!" << endl;
+            if (!playerBlack->isAI()) userMgr->recordGameResult(false);
+            if (!playerWhite->isAI()) userMgr->recordGameResult(false);
+        }
+        view->getUserInput("按回车返回...");
+    }
+
+    void gameLoop() {
+        bool running = true;
+        // 机机对战时按搜索估值裁决：无望一方认输，长时间均势判和
+        bool adjudicate = playerBlack->isAI() && playerWhite->isAI();
+        Adjudicator adjudicator(gameType);
+        while (running) {
+            Player* p = (currentTurn == BLACK) ? playerBlack.get() : playerWhite.get();
+            string msg = "轮到 " + p->getName() + " (" + (currentTurn==BLACK?"黑":"白") + ")";
+            view->displayBoard(*board, currentTurn, msg);
+
+            if (rule->supportsPass()) {
+                if (!rule->hasValidMove(currentTurn)) {
+                    cout << "无子可下，被迫弃权 (Pass)!" << endl;
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                    saveState();
+                    passCount++;
+                    moveHistory.push_back({-1, -1}); 
+                    rule->makeMove(-1, -1, currentTurn);
+                    if (rule->isTerminal()) {
+                         goto GAME_OVER;
+                    }
+                    currentTurn = getOpponent(currentTurn);
+                    continue;
+                }
+            }
+
+            Point move = p->getMove(*board, rule.get(), view.get());
+            double expectedScore;
+            if (p->lastOwnership(searchOwnership.ownership, expectedScore)) {
+                searchOwnership.expectedScore = (float)expectedScore;
+                searchOwnershipHash = board->getHash();
+            }
+
+            if (move.x == -2) { // Undo
+                if (undoStack.empty()) { cout << "无法悔棋" << endl; continue; }
+                GameState prev = undoStack.top(); undoStack.pop();
+                *board = prev.board; currentTurn = prev.currentPlayer; passCount = prev.passCount; moveHistory = prev.moveHistory;
+                rule->resync(passCount);
+                continue;
+            }
+            if (move.x == -3) { // Save
+                string fname = view->getUserInput("输入文件名: ");
+                saveGame(fname);
+                continue;
+            }
+            if (move.x == -4) { // Quit
+                running = false; break;
+            }
+            double value;
+            if (adjudicate && p->lastValue(value)) {
+                GameStatus verdict = adjudicator.record(currentTurn, value, (int)moveHistory.size());
+                if (verdict != PLAYING) {
+                    announceResult(verdict, verdict == DRAW ? "双方均势, 判和!"
+                                                            : string(currentTurn == BLACK ? "黑" : "白") + "方认输!");
+                    running = false;
+                    break;
+                }
+            }
+            if (move.x == -1) { // Manual Pass
+                if (gameType != GO) { cout << "此游戏不支持主动虚着" << endl; continue; }
+                saveState();
+                passCount++;
+                moveHistory.push_back({-1, -1});
+                rule->makeMove(-1, -1, currentTurn);
+                currentTurn = getOpponent(currentTurn);
+                if (rule->isTerminal()) goto GAME_OVER;
+                continue;
+            }
+
+            if (rule->isValidMove(move.x, move.y, currentTurn)) {
+                saveState();
+                rule->makeMove(move.x, move.y, currentTurn);
+                moveHistory.push_back(move);
+                passCount = 0;
+                
+                GameStatus status = rule->status();
+
+                if (status != PLAYING) {
+                    announceResult(status, "游戏结束!");
+                    running = false;
+                } else {
+                    currentTurn = getOpponent(currentTurn);
+                }
+            } else {
+                if (!p->isAI()) cout << "落子不合法!" << endl;
+            }
+        }
+        return;
+
+    GAME_OVER:
+        if (gameType == GO) {
+            // 点目前先按归属估计判定死子并提走，再按数子法计分。终局局面就是最近一次搜索的根局面时
+            // (终局前只有虚着) 直接用搜索中模拟统计的归属，否则现做随机模拟
+            OwnershipEstimate est;
+            if (searchOwnershipHash == board->getHash()) est = searchOwnership;
+            int dead = markDeadStones(*board, static_cast<GoRule&>(*rule), currentTurn, est);
+            if (dead > 0) {
+                cout << "判定死子 " << dead << " 颗，已提走" << endl;
+                rule->resync(rule->getPassCount());
+            }
+            if (!est.ownership.empty())
+                cout << "归属估计: 黑方领先 " << fixed << setprecision(1) << est.expectedScore << " 目 (已计贴目)" << endl;
+        }
+        view->displayBoard(*board, currentTurn, "游戏结束 (双人虚着/无子可下)!");
+        float bScore = 0, wScore = 0;
+        rule->calculateScore(bScore, wScore);
+        cout << fixed << setprecision(2);
+        cout << "黑方: " << bScore << ", 白方: " << wScore << endl;
+        if (rule->status() == BLACK_WIN) {
+            cout << "黑方获胜!" << endl;
+            if (!playerBlack->isAI()) userMgr->recordGameResult(true);
+        } else if (rule->status() == DRAW) {
+            cout << "平局!" << endl;
+        } else {
+            cout << "白方获胜!" << endl;
+            if (!playerWhite->isAI()) userMgr->recordGameResult(true);
+        }
+        view->getUserInput("按回车返回...");
+    }
+
+    void replayMode() {
+        board->clear();
+        rule->initBoard();
+        rule->resync(0);
+        
+        cout << "=== 进入回放模式 ===" << endl;
+        cout << "总步数: " << moveHistory.size() << endl;
+        
+        PieceType p = BLACK;
+        for (size_t i = 0; i < moveHistory.size(); ++i) {
+            view->displayBoard(*board, p, "回放中... (回车下一步, q退出)");
+            string cmd = view->getUserInput("");
+            if (cmd == "q") break;
+
+            Point m = moveHistory[i];
+            if (m.x == -1) cout << "Step " << i+1 << ": Pass" << endl;
+            rule->makeMove(m.x, m.y, p);
+            p = getOpponent(p);
+        }
+        cout << "回放结束。" << endl;
+        view->getUserInput("按回车返回...");
+    }
+
+    void saveGame(string filename) {
+        ofstream file(filename);
+        file << (int)gameType << " " << (int)currentTurn << " " << passCount << endl;
+        file << board->serialize() << endl;
+        file << moveHistory.size() << endl;
+        for(auto p : moveHistory) file << p.x << " " << p.y << " ";
+        file.close();
+        cout << "存档成功!" << endl;
+    }
+
+    bool loadGame(string filename) {
+        ifstream file(filename);
+        if (!file.is_open()) return false;
+        int gt, ct;
+        file >> gt >> ct >> passCount;
+        gameType = (GameType)gt;
+        currentTurn = (PieceType)ct;
+        
+        stringstream ss;
+        string dummy; getline(file, dummy); 
+        string boardStr; getline(file, boardStr);
+        ss << boardStr;
+        
+        board = make_unique<Board>(boardSizeFor(gameType)); 
+        board->deserialize(ss); 
+        
+        rule = createRule(gameType, board.get());
+        rule->resync(passCount);
+
+        int histSize;
+        file >> histSize;
+        moveHistory.clear();
+        for(int i=0; i<histSize; ++i) {
+            int x, y; file >> x >> y;
+            moveHistory.push_back({x, y});
+        }
+        
+        setupPlayers(1, userMgr->getCurrentUsername()); 
+        
+        return true;
+    }
+};
+
+// ==========================================
+// 7. 无界面工具 (命令行模式)
+// ==========================================
+
+GameType parseGameType(const string& name) {
+    if (name == "gomoku") return GOMOKU;
+    if (name == "go") return GO;
+    return REVERSI;
+}
+
+string gameTypeName(GameType type) {
+    if (type == GOMOKU) return "gomoku";
+    if (type == GO) return "go";
+    return "reversi";
+}
+
+// --- 自对弈样本格式 (固定 schema，小端) ---
+// 分片文件头 16 字节: "SPD1" | uint16 version | uint8 gameType | uint8 boardSize | uint32 recordSize | uint32 reserved
+// 每条记录 recordSize 字节:
+//   uint8 sideToMove | int8 result (行棋方视角: 1 胜 / 0 和 / -1 负) | uint16 moveNumber
+//   uint8 stones[(N*N + 3) / 4]   每点 2 bit (0 空 / 1 黑 / 2 白)，按行优先
+//   uint16 visits[N*N + 1]        根节点访问次数，最后一项为虚着，超过 65535 截断
+struct SelfPlayFormat {
+    static const uint16_t VERSION = 1;
+    static const int HEADER_SIZE = 16;
+
+    static int stoneBytes(int n) { return (n * n + 3) / 4; }
+    static int recordSize(int n) { return 4 + stoneBytes(n) + 2 * (n * n + 1); }
+
+    static void writeHeader(ostream& out, GameType type, int n) {
+        uint8_t header[HEADER_SIZE] = {'S', 'P', 'D', '1'};
+        uint16_t version = VERSION;
+        uint32_t size = recordSize(n);
+        memcpy(header + 4, &version, 2);
+        header[6] = (uint8_t)type;
+        header[7] = (uint8_t)n;
+        memcpy(header + 8, &size, 4);
+        out.write((const char*)header, HEADER_SIZE);
+    }
+
+    // 局面与访问分布编码为一条记录 (result 在终局后回填)
+    static void encode(const Board& board, PieceType toMove, int moveNumber, const SearchStats& st,
+                       vector<uint8_t>& record) {
+        int n = board.getSize();
+        record.assign(recordSize(n), 0);
+        record[0] = (uint8_t)toMove;
+        uint16_t mn = (uint16_t)moveNumber;
+        memcpy(&record[2], &mn, 2);
+        uint8_t* stones = &record[4];
+        for (int i = 0; i < n * n; ++i)
+            stones[i / 4] |= (uint8_t)(board.getPiece(i / n, i % n) << (2 * (i % 4)));
+        uint8_t* visits = stones + stoneBytes(n);
+        for (size_t k = 0; k < st.moves.size(); ++k) {
+            int idx = st.moves[k].x < 0 ? n * n : st.moves[k].x * n + st.moves[k].y;
+            uint16_t v = (uint16_t)min(st.visits[k], 65535);
+            memcpy(visits + 2 * idx, &v, 2);
+        }
+    }
+};
+
+// --- 自对弈流水线：多个无界面 MCTS 对局并发运行，样本按分片写入 ---
+struct SelfPlayOptions {
+    GameType type = REVERSI;
+    int games = 100;
+    string outDir = "selfplay";
+    int workers = 1;          // 并发对局数
+    int playouts = 200;       // 每步模拟次数
+    int gamesPerShard = 500;  // 每个分片文件包含的对局数
+    int sampleMoves = 8;      // 开局若干手按访问次数比例随机落子，增加对局多样性
+    bool adjudicate = true;   // 按搜索估值提前结束对局 (认输 / 判和)
+    AdjudicationConfig adjudication;
+    double calibrationFraction = 0.1; // 这部分对局只记录裁决、照常下完，用来统计误判率
+};
+
+class SelfPlayRunner {
+private:
+    SelfPlayOptions opt;
+    atomic<int> nextGame;
+    atomic<long long> positions;
+    atomic<int> adjudicated, calibrated, misjudged;
+    string runTag;
+
+    // 按访问次数比例随机选择着法
+    static Point sampleByVisits(const SearchStats& st, FastRandom& rng) {
+        long long total = 0;
+        for (int v : st.visits) total += v;
+        if (total <= 0) return st.moves.empty() ? Point{-1, -1} : st.moves[0];
+        long long r = (long long)(((uint64_t)rng.next() << 32 | rng.next()) % (uint64_t)total);
+        for (size_t k = 0; k < st.moves.size(); ++k) {
+            r -= st.visits[k];
+            if (r < 0) return st.moves[k];
+        }
+        return st.moves.back();
+    }
+
+    // 下完一局，返回该局全部样本 (结果已回填)
+    void playGame(SearchEngine& engine, FastRandom& rng, vector<vector<uint8_t>>& samples) {
+        int n = boardSizeFor(opt.type);
+        Board board(n);
+        unique_ptr<GameRule> rule = createRule(opt.type, &board);
+        rule->initBoard();
+        PieceType turn = BLACK;
+        vector<PieceType> sides;
+        samples.clear();
+        Adjudicator adjudicator(opt.type, opt.adjudication);
+        bool calibrating = rng.below(1000) < (int)(opt.calibrationFraction * 1000);
+        GameStatus verdict = PLAYING; // 第一次给出的裁决
+        int maxPlies = 2 * n * n;
+        for (int ply = 0; ply < maxPlies && !rule->isTerminal(); ++ply) {
+            if (!rule->hasValidMove(turn)) {
+                rule->makeMove(-1, -1, turn); // 被迫虚着不记录样本
+                turn = getOpponent(turn);
+                continue;
+            }
+            Point move = engine.search(board, *rule, turn);
+            const SearchStats& st = engine.lastStats();
+            samples.emplace_back();
+            SelfPlayFormat::encode(board, turn, ply, st, samples.back());
+            sides.push_back(turn);
+            if (opt.adjudicate && verdict == PLAYING) {
+                verdict = adjudicator.record(turn, st.rootValue, ply);
+                if (verdict != PLAYING && !calibrating) break;
+            }
+            if (ply < opt.sampleMoves) move = sampleByVisits(st, rng);
+            rule->makeMove(move.x, move.y, turn);
+            turn = getOpponent(turn);
+        }
+
+        GameStatus status = rule->status();
+        if (verdict != PLAYING && !calibrating) {
+            status = verdict;
+            adjudicated++;
+        } else {
+            if (status == PLAYING) { // 达到步数上限，按比分判定
+                float b, w;
+                rule->calculateScore(b, w);
+                status = b > w ? BLACK_WIN : (w > b ? WHITE_WIN : DRAW);
+            }
+            if (verdict != PLAYING) {
+                calibrated++;
+                if (verdict != status) misjudged++;
+            }
+        }
+        for (size_t i = 0; i < samples.size(); ++i) {
+            int8_t result = 0;
+            if (status == BLACK_WIN) result = (sides[i] == BLACK) ? 1 : -1;
+            else if (status == WHITE_WIN) result = (sides[i] == WHITE) ? 1 : -1;
+            samples[i][1] = (uint8_t)result;
+        }
+    }
+
+    void workerMain(int id) {
+        MCTSConfig config;
+        config.usePUCT = true;
+        config.threads = 1;
+        config.playoutLimit = opt.playouts;
+        config.timeLimitMs = std::numeric_limits<int>::max() / 2;
+        unique_ptr<SearchEngine> engine = createSearchEngine(opt.type, config);
+        FastRandom rng((uint64_t)chrono::steady_clock::now().time_since_epoch().count() + 7919ULL * id);
+        int n = boardSizeFor(opt.type);
+
+        ofstream shard;
+        int shardIndex = 0, gamesInShard = 0;
+        vector<vector<uint8_t>> samples;
+        while (nextGame.fetch_add(1) < opt.games) {
+            if (!shard.is_open() || gamesInShard >= opt.gamesPerShard) {
+                if (shard.is_open()) shard.close();
+                stringstream name;
+                name << opt.outDir << "/" << gameTypeName(opt.type) << "_" << runTag << "_w" << id
+                     << "_" << setw(4) << setfill('0') << shardIndex++ << ".spd";
+                shard.open(name.str(), ios::binary);
+                SelfPlayFormat::writeHeader(shard, opt.type, n);
+                gamesInShard = 0;
+            }
+            playGame(*engine, rng, samples);
+            for (auto& rec : samples) shard.write((const char*)rec.data(), rec.size());
+            shard.flush();
+            gamesInShard++;
+            positions += (long long)samples.size();
+        }
+    }
+
+public:
+    explicit SelfPlayRunner(const SelfPlayOptions& o)
+        : opt(o), nextGame(0), positions(0), adjudicated(0), calibrated(0), misjudged(0) {
+        runTag = to_string((long long)time(0));
+    }
+
+    int run() {
+        error_code ec;
+        filesystem::create_directories(opt.outDir, ec);
+        if (ec) {
+            cerr << "无法创建输出目录: " << opt.outDir << endl;
+            return 1;
+        }
+        auto start = chrono::steady_clock::now();
+        vector<thread> pool;
+        for (int i = 0; i < max(1, opt.workers); ++i) pool.emplace_back(&SelfPlayRunner::workerMain, this, i);
+        for (auto& t : pool) t.join();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "自对弈完成: " << opt.games << " 局, " << positions << " 个局面, "
+             << fixed << setprecision(1) << positions / max(secs, 1e-9) << " 局面/秒" << endl;
+        if (opt.adjudicate)
+            cout << "裁决提前结束 " << adjudicated << " 局; 校验对局中裁决 " << calibrated
+                 << " 次, 与实际结果不符 " << misjudged << " 次" << endl;
+        return 0;
+    }
+};
+
+// --- 浮点向量内核 (训练用)：y += a * x 与点积，运行时选择 AVX2/FMA 或标量实现 ---
+static void axpyScalar(float a, const float* x, float* y, int n) {
+    for (int i = 0; i < n; ++i) y[i] += a * x[i];
+}
+static float dotScalar(const float* x, const float* y, int n) {
+    float sum = 0;
+    for (int i = 0; i < n; ++i) sum += x[i] * y[i];
+    return sum;
+}
+
+#ifdef HW2_X86_SIMD
+__attribute__((target("avx2,fma")))
+static void axpyAVX2(float a, const float* x, float* y, int n) {
+    __m256 va = _mm256_set1_ps(a);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    for (; i < n; ++i) y[i] += a * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+static float dotAVX2(const float* x, const float* y, int n) {
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) acc = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), acc);
+    float lanes[8];
+    _mm256_storeu_ps(lanes, acc);
+    float sum = lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    for (; i < n; ++i) sum += x[i] * y[i];
+    return sum;
+}
+#endif
+
+typedef void (*AxpyFn)(float, const float*, float*, int);
+typedef float (*DotFn)(const float*, const float*, int);
+
+static bool cpuHasAVX2FMA() {
+#ifdef HW2_X86_SIMD
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+#ifdef HW2_X86_SIMD
+static const AxpyFn axpyF32 = cpuHasAVX2FMA() ? axpyAVX2 : axpyScalar;
+static const DotFn dotF32 = cpuHasAVX2FMA() ? dotAVX2 : dotScalar;
+#else
+static const AxpyFn axpyF32 = axpyScalar;
+static const DotFn dotF32 = dotScalar;
+#endif
+
+// --- 自对弈样本读取：逐个分片流式读取，经洗牌缓冲区打乱顺序 ---
+struct TrainingSample {
+    int n;
+    PieceType toMove;
+    float result;           // 行棋方视角 [-1, 1]
+    vector<uint8_t> stones; // 每点 0 空 / 1 黑 / 2 白
+    vector<float> policy;   // 归一化后的访问分布，最后一项为虚着
+};
+
+class ShardReader {
+private:
+    vector<string> files;
+    size_t fileIndex = 0;
+    ifstream current;
+    int recordSize = 0;
+    int boardSize = 0;
+    GameType type;
+    vector<uint8_t> record;
+
+    bool openNext() {
+        while (fileIndex < files.size()) {
+            current.close();
+            current.clear();
+            current.open(files[fileIndex++], ios::binary);
+            uint8_t header[SelfPlayFormat::HEADER_SIZE];
+            if (!current.read((char*)header, sizeof(header))) continue;
+            uint32_t rs;
+            memcpy(&rs, header + 8, 4);
+            if (memcmp(header, "SPD1", 4) != 0 || header[6] != (uint8_t)type || header[7] != boardSize ||
+                (int)rs != recordSize) {
+                cerr << "跳过格式不符的分片: " << files[fileIndex - 1] << endl;
+                continue;
+            }
+            return true;
+        }
+        return false;
+    }
+
+public:
+    ShardReader(const vector<string>& f, GameType t) : files(f), type(t) {
+        boardSize = boardSizeFor(t);
+        recordSize = SelfPlayFormat::recordSize(boardSize);
+        record.resize(recordSize);
+    }
+
+    void rewind(FastRandom& rng) {
+        for (size_t k = files.size(); k > 1; --k) swap(files[k - 1], files[rng.below((int)k)]);
+        fileIndex = 0;
+        current.close();
+        current.clear();
+    }
+
+    bool next(TrainingSample& out) {
+        while (!current.is_open() || !current.read((char*)record.data(), recordSize)) {
+            if (!openNext()) return false;
+        }
+        int n = boardSize, area = n * n;
+        out.n = n;
+        out.toMove = (PieceType)record[0];
+        out.result = (float)(int8_t)record[1];
+        out.stones.resize(area);
+        for (int i = 0; i < area; ++i) out.stones[i] = (record[4 + i / 4] >> (2 * (i % 4))) & 3;
+        out.policy.assign(area + 1, 0.0f);
+        const uint8_t* visits = record.data() + 4 + SelfPlayFormat::stoneBytes(n);
+        float total = 0;
+        for (int i = 0; i <= area; ++i) {
+            uint16_t v;
+            memcpy(&v, visits + 2 * i, 2);
+            out.policy[i] = v;
+            total += v;
+        }
+        if (total > 0) for (auto& p : out.policy) p /= total;
+        return true;
+    }
+};
+
+// 展开命令行给出的分片文件或目录 (目录下取全部 .spd)
+vector<string> listShardFiles(const vector<string>& inputs) {
+    vector<string> files;
+    for (auto& in : inputs) {
+        error_code ec;
+        if (filesystem::is_directory(in, ec)) {
+            for (auto& e : filesystem::directory_iterator(in, ec))
+                if (e.path().extension() == ".spd") files.push_back(e.path().string());
+        } else {
+            files.push_back(in);
+        }
+    }
+    sort(files.begin(), files.end());
+    return files;
+}
+
+// 8 种对称变换 (旋转 + 镜像) 下的坐标映射
+static int symmetryIndex(int sym, int x, int y, int n) {
+    if (sym & 1) x = n - 1 - x;
+    if (sym & 2) y = n - 1 - y;
+    if (sym & 4) swap(x, y);
+    return x * n + y;
+}
+
+// --- 激活值直方图 (量化标定用)：正值按 log2 分桶，每个 2 的幂 32 桶，覆盖 2^-16 .. 2^16 ---
+struct ActivationHistogram {
+    static const int BINS = 32 * 32;
+    vector<long long> counts = vector<long long>(BINS, 0);
+    long long total = 0;
+
+    void add(float v) {
+        if (v <= 0) return;
+        counts[min(BINS - 1, max(0, (int)((log2f(v) + 16) * 32)))]++;
+        total++;
+    }
+    void merge(const ActivationHistogram& other) {
+        for (int b = 0; b < BINS; ++b) counts[b] += other.counts[b];
+        total += other.total;
+    }
+    // 至少 fraction 的正激活不超过返回值 (取所在桶的上界)
+    float quantile(double fraction) const {
+        long long need = (long long)ceil(fraction * total), sum = 0;
+        for (int b = 0; b < BINS; ++b) {
+            sum += counts[b];
+            if (sum >= need && sum > 0) return exp2f((b + 1) / 32.0f - 16);
+        }
+        return 0.0f;
+    }
+};
+
+// --- 浮点训练网络：与 PolicyValueNet 同构，导出时量化为 int8 模型文件 ---
+class TrainerNet {
+public:
+    int channels, numLayers, n, area;
+    // 参数按连续数组存放，便于多线程梯度归约与 SGD 更新
+    // 卷积权重训练布局为 [3x3 位置][输入通道][输出通道]
+    vector<float> params;
+    vector<size_t> convOffset, biasOffset;
+    size_t policyOffset, passOffset, valueOffset, headBiasOffset;
+
+    int inChannels(int l) const { return l == 0 ? PolicyValueNet::INPUT_PLANES : channels; }
+
+    TrainerNet(int c, int layers, int boardSize) : channels(c), numLayers(layers), n(boardSize), area(boardSize * boardSize) {
+        size_t off = 0;
+        for (int l = 0; l < numLayers; ++l) {
+            convOffset.push_back(off);
+            off += (size_t)9 * inChannels(l) * channels;
+            biasOffset.push_back(off);
+            off += channels;
+        }
+        policyOffset = off; off += channels;
+        passOffset = off; off += channels;
+        valueOffset = off; off += channels;
+        headBiasOffset = off; off += 3;
+        params.assign(off, 0.0f);
+    }
+
+    void randomInit(uint64_t seed) {
+        mt19937 gen((uint32_t)seed);
+        for (int l = 0; l < numLayers; ++l) {
+            normal_distribution<float> dist(0.0f, sqrtf(2.0f / (9 * inChannels(l)))); // He 初始化
+            for (size_t i = 0; i < (size_t)9 * inChannels(l) * channels; ++i) params[convOffset[l] + i] = dist(gen);
+        }
+        normal_distribution<float> head(0.0f, 0.1f);
+        for (size_t i = policyOffset; i < headBiasOffset; ++i) params[i] = head(gen);
+    }
+
+    // 从已有的量化模型反量化继续训练 (结构不符时返回 false)
+    bool loadQuantized(const string& path) {
+        ifstream file(path, ios::binary);
+        if (!file.is_open()) return false;
+        uint32_t header[8];
+        if (!file.read((char*)header, sizeof(header))) return false;
+        if (memcmp(header, "PVN1", 4) != 0 || header[1] != PolicyValueNet::VERSION ||
+            (int)header[3] != channels || (int)header[4] != numLayers) return false;
+        for (int l = 0; l < numLayers; ++l) {
+            int inC = inChannels(l), rowLen = PolicyValueNet::rowLength(inC);
+            float outScale;
+            vector<float> wScale(channels);
+            vector<int8_t> w((size_t)channels * rowLen);
+            file.read((char*)&outScale, 4);
+            file.read((char*)wScale.data(), 4 * channels);
+            file.read((char*)&params[biasOffset[l]], 4 * channels);
+            file.read((char*)w.data(), w.size());
+            // 推理时 acc * inScale * wScale 等价于实数激活乘以实数权重 q * wScale
+            for (int oc = 0; oc < channels; ++oc)
+                for (int t = 0; t < 9; ++t)
+                    for (int ic = 0; ic < inC; ++ic)
+                        params[convOffset[l] + ((size_t)t * inC + ic) * channels + oc] = w[(size_t)oc * rowLen + t * inC + ic] * wScale[oc];
+        }
+        file.read((char*)&params[policyOffset], 4 * (3 * channels + 3));
+        return (bool)file;
+    }
+
+    // 单个样本的前向 + 反向所需的中间结果
+    struct Workspace {
+        vector<vector<float>> acts; // acts[0] 为输入平面，acts[l+1] 为第 l 层 ReLU 输出
+        vector<float> grad, gradNext;
+        vector<float> logits;
+        vector<float> pooled;
+    };
+
+    void prepare(Workspace& ws) const {
+        ws.acts.resize(numLayers + 1);
+        ws.acts[0].assign((size_t)area * PolicyValueNet::INPUT_PLANES, 0.0f);
+        for (int l = 0; l < numLayers; ++l) ws.acts[l + 1].assign((size_t)area * channels, 0.0f);
+        ws.logits.assign(area + 1, 0.0f);
+        ws.pooled.assign(channels, 0.0f);
+    }
+
+    // 权重衰减系数：只衰减卷积与输出头的权重，偏置 (含输出头偏置) 不衰减
+    vector<float> decayMask(float weightDecay) const {
+        vector<float> decay(params.size(), weightDecay);
+        for (int l = 0; l < numLayers; ++l) fill_n(decay.begin() + biasOffset[l], channels, 0.0f);
+        fill_n(decay.begin() + headBiasOffset, 3, 0.0f);
+        return decay;
+    }
+
+    // 输入平面与各卷积层的前向，结果留在 ws.acts
+    void forward(const TrainingSample& s, int sym, Workspace& ws) const {
+        const int P = PolicyValueNet::INPUT_PLANES;
+        vector<float>& in = ws.acts[0];
+        PieceType me = s.toMove, opp = getOpponent(me);
+        for (int x = 0; x < n; ++x) {
+            for (int y = 0; y < n; ++y) {
+                float* a = &in[(size_t)symmetryIndex(sym, x, y, n) * P];
+                PieceType p = (PieceType)s.stones[x * n + y];
+                a[0] = p == me; a[1] = p == opp; a[2] = p == EMPTY; a[3] = 1.0f;
+            }
+        }
+        // 卷积层
+        for (int l = 0; l < numLayers; ++l) {
+            int inC = inChannels(l);
+            const float* W = &params[convOffset[l]];
+            const float* B = &params[biasOffset[l]];
+            const vector<float>& src = ws.acts[l];
+            vector<float>& dst = ws.acts[l + 1];
+            for (int x = 0; x < n; ++x) {
+                for (int y = 0; y < n; ++y) {
+                    float* o = &dst[(size_t)(x * n + y) * channels];
+                    memcpy(o, B, sizeof(float) * channels);
+                    int t = 0;
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        for (int dy = -1; dy <= 1; ++dy, ++t) {
+                            int nx = x + dx, ny = y + dy;
+                            if (nx < 0 || nx >= n || ny < 0 || ny >= n) continue;
+                            const float* a = &src[(size_t)(nx * n + ny) * inC];
+                            for (int ic = 0; ic < inC; ++ic)
+                                if (a[ic] != 0.0f) axpyF32(a[ic], W + ((size_t)t * inC + ic) * channels, o, channels);
+                        }
+                    }
+                    for (int c = 0; c < channels; ++c) if (o[c] < 0) o[c] = 0;
+                }
+            }
+        }
+    }
+
+    // 前向 + 反向，梯度累加到 grad，返回 (策略交叉熵, 价值均方误差)
+    pair<float, float> trainSample(const TrainingSample& s, int sym, Workspace& ws, vector<float>& grad) const {
+        forward(s, sym, ws);
+        // 输出头
+        const vector<float>& last = ws.acts[numLayers];
+        const float* pw = &params[policyOffset];
+        const float* sw = &params[passOffset];
+        const float* vw = &params[valueOffset];
+        const float* hb = &params[headBiasOffset];
+        fill(ws.pooled.begin(), ws.pooled.end(), 0.0f);
+        for (int i = 0; i < area; ++i) axpyF32(1.0f / area, &last[(size_t)i * channels], ws.pooled.data(), channels);
+        float maxLogit = -std::numeric_limits<float>::infinity();
+        for (int i = 0; i < area; ++i) {
+            ws.logits[i] = hb[0] + dotF32(pw, &last[(size_t)i * channels], channels);
+            maxLogit = max(maxLogit, ws.logits[i]);
+        }
+        ws.logits[area] = hb[1] + dotF32(sw, ws.pooled.data(), channels);
+        maxLogit = max(maxLogit, ws.logits[area]);
+        float total = 0;
+        for (auto& z : ws.logits) { z = expf(z - maxLogit); total += z; }
+        float policyLoss = 0;
+        // 对称变换后的策略目标
+        for (int x = 0; x < n; ++x) {
+            for (int y = 0; y < n; ++y) {
+                int i = symmetryIndex(sym, x, y, n);
+                float target = s.policy[x * n + y];
+                ws.logits[i] /= total;
+                if (target > 0) policyLoss -= target * logf(max(ws.logits[i], 1e-12f));
+                ws.logits[i] -= target; // 此后 logits 保存 dL/dlogit = p - pi
+            }
+        }
+        ws.logits[area] /= total;
+        if (s.policy[area] > 0) policyLoss -= s.policy[area] * logf(max(ws.logits[area], 1e-12f));
+        ws.logits[area] -= s.policy[area];
+
+        float v = tanhf(hb[2] + dotF32(vw, ws.pooled.data(), channels));
+        float valueLoss = (v - s.result) * (v - s.result);
+        float dv = 2.0f * (v - s.result) * (1.0f - v * v);
+
+        // 输出头梯度
+        float* g = grad.data();
+        for (int i = 0; i < area; ++i) {
+            axpyF32(ws.logits[i], &last[(size_t)i * channels], g + policyOffset, channels);
+            g[headBiasOffset] += ws.logits[i];
+        }
+        axpyF32(ws.logits[area], ws.pooled.data(), g + passOffset, channels);
+        g[headBiasOffset + 1] += ws.logits[area];
+        axpyF32(dv, ws.pooled.data(), g + valueOffset, channels);
+        g[headBiasOffset + 2] += dv;
+
+        // 最后一层激活的梯度：逐点策略项 + 经全局平均池化的虚着/价值项
+        ws.grad.assign((size_t)area * channels, 0.0f);
+        vector<float> pooledGrad(channels, 0.0f);
+        axpyF32(ws.logits[area] / area, sw, pooledGrad.data(), channels);
+        axpyF32(dv / area, vw, pooledGrad.data(), channels);
+        for (int i = 0; i < area; ++i) {
+            float* d = &ws.grad[(size_t)i * channels];
+            memcpy(d, pooledGrad.data(), sizeof(float) * channels);
+            axpyF32(ws.logits[i], pw, d, channels);
+        }
+
+        // 卷积层反向
+        for (int l = numLayers - 1; l >= 0; --l) {
+            int inC = inChannels(l);
+            const float* W = &params[convOffset[l]];
+            float* dW = g + convOffset[l];
+            float* dB = g + biasOffset[l];
+            const vector<float>& src = ws.acts[l];
+            const vector<float>& out = ws.acts[l + 1];
+            bool needInputGrad = l > 0;
+            if (needInputGrad) ws.gradNext.assign((size_t)area * inC, 0.0f);
+            for (int x = 0; x < n; ++x) {
+                for (int y = 0; y < n; ++y) {
+                    size_t idx = (size_t)(x * n + y) * channels;
+                    float* d = &ws.grad[idx];
+                    for (int c = 0; c < channels; ++c) if (out[idx + c] <= 0) d[c] = 0; // ReLU
+                    for (int c = 0; c < channels; ++c) dB[c] += d[c];
+                    int t = 0;
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        for (int dy = -1; dy <= 1; ++dy, ++t) {
+                            int nx = x + dx, ny = y + dy;
+                            if (nx < 0 || nx >= n || ny < 0 || ny >= n) continue;
+                            size_t nidx = (size_t)(nx * n + ny) * inC;
+                            for (int ic = 0; ic < inC; ++ic) {
+                                size_t w = ((size_t)t * inC + ic) * channels;
+                                if (src[nidx + ic] != 0.0f) axpyF32(src[nidx + ic], d, dW + w, channels);
+                                if (needInputGrad) ws.gradNext[nidx + ic] += dotF32(W + w, d, channels);
+                            }
+                        }
+                    }
+                }
+            }
+            if (needInputGrad) ws.grad.swap(ws.gradNext);
+        }
+        return {policyLoss, valueLoss};
+    }
+
+    // 量化导出为 PolicyValueNet 可加载的模型文件
+    // clip[l] 为第 l 层激活的截断上限 (由标定得到)，超出部分在推理时饱和到 127
+    bool saveQuantized(const string& path, const vector<float>& clip) const {
+        ofstream out(path, ios::binary);
+        if (!out.is_open()) return false;
+        uint32_t header[8] = {0, PolicyValueNet::VERSION, (uint32_t)PolicyValueNet::INPUT_PLANES,
+                              (uint32_t)channels, (uint32_t)numLayers, 0, 0, 0};
+        memcpy(header, "PVN1", 4);
+        out.write((const char*)header, sizeof(header));
+        for (int l = 0; l < numLayers; ++l) {
+            int inC = inChannels(l), rowLen = PolicyValueNet::rowLength(inC);
+            const float* W = &params[convOffset[l]];
+            float outScale = clip[l] > 0 ? clip[l] / 127 : 1.0f / 127;
+            vector<float> wScale(channels);
+            for (int oc = 0; oc < channels; ++oc) {
+                float m = 0;
+                for (int k = 0; k < 9 * inC; ++k) m = max(m, fabsf(W[(size_t)k * channels + oc]));
+                wScale[oc] = m > 0 ? m / 127 : 1.0f;
+            }
+            vector<int8_t> q((size_t)channels * rowLen, 0);
+            for (int oc = 0; oc < channels; ++oc)
+                for (int k = 0; k < 9 * inC; ++k)
+                    q[(size_t)oc * rowLen + k] = (int8_t)lrintf(W[(size_t)k * channels + oc] / wScale[oc]);
+            out.write((const char*)&outScale, 4);
+            out.write((const char*)wScale.data(), 4 * channels);
+            out.write((const char*)&params[biasOffset[l]], 4 * channels);
+            out.write((const char*)q.data(), q.size());
+        }
+        out.write((const char*)&params[policyOffset], 4 * (3 * channels + 3));
+        return (bool)out;
+    }
+};
+
+// --- 多线程 CPU 训练器：数据并行，每个小批量由各线程分摊样本并归约梯度 ---
+struct TrainOptions {
+    GameType type = REVERSI;
+    string modelPath;
+    vector<string> inputs;   // 分片文件或目录
+    int epochs = 1;
+    int threads = 1;
+    int channels = 32;
+    int layers = 4;
+    int batch = 64;
+    float lr = 0.01f;
+    float momentum = 0.9f;
+    float weightDecay = 1e-4f;
+    int shuffleBuffer = 20000;
+    int calibrationSamples = 4096;      // 量化标定抽取的样本数
+    double calibrationPercentile = 99.99; // 各层截断上限取正激活的该分位数
+};
+
+class Trainer {
+private:
+    TrainOptions opt;
+
+    // 量化标定：训练结束后用最终权值，对整个数据集均匀抽样 (蓄水池抽样) 做前向，
+    // 各层截断上限取正激活的分位数，少数离群激活只会饱和，不会撑大整层的量化步长
+    vector<float> calibrate(const TrainerNet& net, ShardReader& reader, FastRandom& rng,
+                            vector<TrainerNet::Workspace>& spaces) const {
+        vector<TrainingSample> samples;
+        TrainingSample s;
+        long long seen = 0;
+        reader.rewind(rng);
+        while (reader.next(s)) {
+            seen++;
+            if ((int)samples.size() < opt.calibrationSamples) samples.push_back(std::move(s));
+            else {
+                long long k = (long long)(rng.next() % (uint64_t)seen);
+                if (k < opt.calibrationSamples) samples[k] = std::move(s);
+            }
+        }
+        int T = (int)spaces.size();
+        vector<vector<ActivationHistogram>> hist(T, vector<ActivationHistogram>(opt.layers));
+        vector<thread> workers;
+        for (int t = 0; t < T; ++t) {
+            workers.emplace_back([&, t] {
+                for (size_t i = t; i < samples.size(); i += T) {
+                    net.forward(samples[i], (int)(i % 8), spaces[t]);
+                    for (int l = 0; l < opt.layers; ++l)
+                        for (float v : spaces[t].acts[l + 1]) hist[t][l].add(v);
+                }
+            });
+        }
+        for (auto& th : workers) th.join();
+        vector<float> clip(opt.layers);
+        for (int l = 0; l < opt.layers; ++l) {
+            for (int t = 1; t < T; ++t) hist[0][l].merge(hist[t][l]);
+            clip[l] = hist[0][l].quantile(opt.calibrationPercentile / 100);
+            cout << "标定 第 " << l + 1 << " 层激活截断上限 " << clip[l] << endl;
+        }
+        return clip;
+    }
+
+public:
+    explicit Trainer(const TrainOptions& o) : opt(o) {}
+
+    int run() {
+        vector<string> files = listShardFiles(opt.inputs);
+        if (files.empty()) {
+            cerr << "没有找到样本分片 (.spd)" << endl;
+            return 1;
+        }
+        int n = boardSizeFor(opt.type);
+        TrainerNet net(opt.channels, opt.layers, n);
+        FastRandom rng((uint64_t)time(0));
+        if (net.loadQuantized(opt.modelPath)) cout << "从已有模型继续训练: " << opt.modelPath << endl;
+        else net.randomInit(rng.next());
+
+        int T = max(1, opt.threads);
+        vector<TrainerNet::Workspace> spaces(T);
+        vector<vector<float>> grads(T, vector<float>(net.params.size()));
+        for (auto& ws : spaces) net.prepare(ws);
+        vector<float> velocity(net.params.size(), 0.0f);
+        vector<float> decay = net.decayMask(opt.weightDecay);
+
+        ShardReader reader(files, opt.type);
+        vector<TrainingSample> shuffle;   // 洗牌缓冲区
+        vector<TrainingSample> batch(opt.batch);
+        vector<int> syms(opt.batch);
+        vector<double> policyLoss(T), valueLoss(T);
+        auto start = chrono::steady_clock::now();
+        long long seen = 0;
+
+        for (int epoch = 0; epoch < opt.epochs; ++epoch) {
+            reader.rewind(rng);
+            shuffle.clear();
+            bool exhausted = false;
+            int step = 0;
+            while (true) {
+                // 填充小批量：缓冲区未满时先读满，之后每读入一条随机换出一条
+                int count = 0;
+                while (count < opt.batch) {
+                    TrainingSample s;
+                    bool got = !exhausted && reader.next(s);
+                    if (!got) exhausted = true;
+                    if (got && (int)shuffle.size() < opt.shuffleBuffer) { shuffle.push_back(std::move(s)); continue; }
+                    if (shuffle.empty()) break;
+                    int k = rng.below((int)shuffle.size());
+                    batch[count] = std::move(shuffle[k]);
+                    if (got) shuffle[k] = std::move(s);
+                    else { shuffle[k] = std::move(shuffle.back()); shuffle.pop_back(); }
+                    syms[count] = rng.below(8); // 随机对称增强
+                    count++;
+                }
+                if (count == 0) break;
+
+                vector<thread> workers;
+                for (int t = 0; t < T; ++t) {
+                    workers.emplace_back([&, t] {
+                        fill(grads[t].begin(), grads[t].end(), 0.0f);
+                        policyLoss[t] = valueLoss[t] = 0;
+                        for (int i = t; i < count; i += T) {
+                            pair<float, float> loss = net.trainSample(batch[i], syms[i], spaces[t], grads[t]);
+                            policyLoss[t] += loss.first;
+                            valueLoss[t] += loss.second;
+                        }
+                    });
+                }
+                for (auto& th : workers) th.join();
+
+                // 归约梯度并做带动量的 SGD 更新
+                double pl = 0, vl = 0;
+                for (int t = 0; t < T; ++t) { pl += policyLoss[t]; vl += valueLoss[t]; }
+                for (int t = 1; t < T; ++t) axpyF32(1.0f, grads[t].data(), grads[0].data(), (int)grads[0].size());
+                float scale = 1.0f / count;
+                for (size_t i = 0; i < net.params.size(); ++i) {
+                    float g = grads[0][i] * scale + decay[i] * net.params[i];
+                    velocity[i] = opt.momentum * velocity[i] - opt.lr * g;
+                    net.params[i] += velocity[i];
+                }
+                seen += count;
+                if (++step % 100 == 0) {
+                    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                    cout << "epoch " << epoch + 1 << " step " << step << fixed << setprecision(4)
+                         << " policy " << pl / count << " value " << vl / count
+                         << setprecision(0) << " (" << seen / max(secs, 1e-9) << " 样本/秒)" << endl;
+                }
             }
-        } 
-        else { // AIvAI: 机机对战
-            // 允许分别设置黑白双方的 AI 难度
-            int levelBlack = 1;
-            string inputB = view->getUserInput("选择黑方AI难度 (1:简单, 2:贪心, 3:MCTS): ");
-            if (inputB == "2") levelBlack = 2;
-            if (inputB == "3") levelBlack = 3;
+        }
+        vector<float> clip = calibrate(net, reader, rng, spaces);
+        if (!net.saveQuantized(opt.modelPath, clip)) {
+            cerr << "写入模型失败: " << opt.modelPath << endl;
+            return 1;
+        }
+        cout << "训练完成: " << seen << " 个样本, 模型已写入 " << opt.modelPath << endl;
+        return 0;
+    }
+};
 
-            int levelWhite = 1;
-            string inputW = view->getUserInput("选择白方AI难度 (1:简单, 2:贪心, 3:MCTS): ");
-            if (inputW == "2") levelWhite = 2;
-            if (inputW == "3") levelWhite = 3;
+// --- 评估权值调优 (Texel 方法)：用逐格线性评估拟合对局结果 ---
+// eval = Σ w[格] · (己方子 - 对方子)，P(行棋方胜) = sigmoid(eval / EVAL_WIN_SCALE)，最小化交叉熵。
+// 权值在 8 种对称变换下绑定；样本经洗牌缓冲区流式读出，每个小批量由各线程分摊梯度，归约后做一次 Adam 更新。
+// 只用于黑白棋：五子棋与围棋的局面价值不由"哪些格子上有子"决定，逐格子数差拟合不出有意义的权值
+struct TuneOptions {
+    GameType type = REVERSI;
+    string outPath;
+    vector<string> inputs;   // 分片文件或目录
+    int epochs = 10;
+    int threads = 1;
+    int batch = 1024;
+    int shuffleBuffer = 100000;
+    float lr = 0.5f;         // Adam 步长 (评估分单位)
+    float l2 = 1e-4f;        // 向初始权值回拉的正则强度
+};
+
+class EvalTuner {
+private:
+    TuneOptions opt;
+    int n;
+    vector<int> classOf;     // 格 -> 对称等价类
+    int classCount = 0;
 
-            playerBlack = make_unique<AIPlayer>(getAIName(levelBlack) + "(B)", BLACK, levelBlack);
-            playerWhite = make_unique<AIPlayer>(getAIName(levelWhite) + "(W)", WHITE, levelWhite);
+    void buildClasses() {
+        classOf.assign((size_t)n * n, -1);
+        map<int, int> canonical;
+        for (int x = 0; x < n; ++x)
+            for (int y = 0; y < n; ++y) {
+                int rep = x * n + y;
+                for (int sym = 1; sym < 8; ++sym) rep = min(rep, symmetryIndex(sym, x, y, n));
+                auto it = canonical.find(rep);
+                if (it == canonical.end()) it = canonical.emplace(rep, classCount++).first;
+                classOf[x * n + y] = it->second;
+            }
+    }
+
+    // 单个样本：累加梯度，返回交叉熵
+    double accumulate(const TrainingSample& s, const vector<double>& w, vector<int>& diff, vector<double>& grad) const {
+        fill(diff.begin(), diff.end(), 0);
+        for (int i = 0; i < n * n; ++i) {
+            if (s.stones[i] == EMPTY) continue;
+            diff[classOf[i]] += (s.stones[i] == s.toMove) ? 1 : -1;
         }
+        double eval = 0;
+        for (int c = 0; c < classCount; ++c) eval += w[c] * diff[c];
+        double p = 1.0 / (1.0 + exp(-eval / EVAL_WIN_SCALE));
+        double y = (s.result + 1.0) * 0.5;
+        double g = (p - y) / EVAL_WIN_SCALE;
+        for (int c = 0; c < classCount; ++c)
+            if (diff[c]) grad[c] += g * diff[c];
+        return -(y * log(max(p, 1e-12)) + (1 - y) * log(max(1 - p, 1e-12)));
     }
 
 public:
-    GameManager() {
-        view = make_unique<ConsoleView>();
-        userMgr = make_unique<UserManager>();
-        srand(time(0));
-    }
+    explicit EvalTuner(const TuneOptions& o) : opt(o), n(boardSizeFor(o.type)) { buildClasses(); }
 
-    void run() {
-        while (true) {
-            if (!userMgr->isLoggedIn()) {
-                view->showMainMenu();
-                string choice = view->getUserInput("请选择: ");
-                if (choice == "1") {
-                    string u = view->getUserInput("用户名: ");
-                    string p = view->getUserInput("密码: ");
-                    if (userMgr->login(u, p)) cout << "登录成功！" << endl;
-                    else cout << "登录失败。" << endl;
-                } else if (choice == "2") {
-                    string u = view->getUserInput("用户名: ");
-                    string p = view->getUserInput("密码: ");
-                    if (userMgr->registerUser(u, p)) cout << "注册成功，请登录。" << endl;
-                    else cout << "用户已存在。" << endl;
-                } else if (choice == "3") {
-                    cout << "以游客身份进入。" << endl;
-                    break; 
-                } else if (choice == "4") {
-                    return;
-                }
-                if (userMgr->isLoggedIn()) break;
-            } else break;
+    int run() {
+        vector<string> files = listShardFiles(opt.inputs);
+        if (files.empty()) {
+            cerr << "没有找到样本分片 (.spd)" << endl;
+            return 1;
         }
+        ShardReader reader(files, opt.type);
+        FastRandom rng((uint64_t)time(0));
 
-        while(true) {
-            cout << "\n欢迎, " << userMgr->getStats(userMgr->getCurrentUsername()) << endl;
-            cout << "1. 开始游戏" << endl;
-            cout << "2. 读取存档/回放" << endl;
-            cout << "3. 退出登录" << endl;
-            string choice = view->getUserInput("请选择: ");
+        // 从当前生效的权值 (已有调优结果或默认表) 出发，按等价类取平均
+        const vector<float>& start = loadEvalWeights(opt.type, n);
+        vector<double> w(classCount, 0.0), prior(classCount, 0.0);
+        vector<int> members(classCount, 0);
+        for (int i = 0; i < n * n; ++i) {
+            prior[classOf[i]] += start[i];
+            members[classOf[i]]++;
+        }
+        for (int c = 0; c < classCount; ++c) w[c] = prior[c] /= members[c];
 
-            if (choice == "3") {
-                userMgr->logout();
-                run(); 
-                return;
-            } else if (choice == "1") {
-                cout << "选择游戏: 1.五子棋 2.围棋 3.黑白棋" << endl;
-                string g = view->getUserInput("> ");
-                if (g == "1") gameType = GOMOKU;
-                else if (g == "2") gameType = GO;
-                else gameType = REVERSI;
+        int T = max(1, opt.threads);
+        vector<vector<double>> grads(T, vector<double>(classCount));
+        vector<vector<int>> diffs(T, vector<int>(classCount));
+        vector<double> losses(T);
+        vector<double> m(classCount, 0.0), v(classCount, 0.0);
+        const double beta1 = 0.9, beta2 = 0.999;
+        vector<TrainingSample> shuffle;   // 洗牌缓冲区
+        vector<TrainingSample> batch(opt.batch);
+        auto startTime = chrono::steady_clock::now();
+        long long seen = 0, step = 0;
 
-                int size = (gameType == REVERSI) ? 8 : 15;
-                if (gameType == GO) size = 19;
-                
-                cout << "选择模式: 1.人人对战 2.人机对战 3.机机对战" << endl;
-                string m = view->getUserInput("> ");
-                
-                board = make_unique<Board>(size);
-                if (gameType == GOMOKU) rule = make_unique<GomokuRule>(board.get());
-                else if (gameType == GO) rule = make_unique<GoRule>(board.get());
-                else rule = make_unique<ReversiRule>(board.get());
-                
-                rule->initBoard();
-                setupPlayers(stoi(m), userMgr->getCurrentUsername());
-                
-                currentTurn = BLACK;
-                passCount = 0;
-                moveHistory.clear();
-                while(!undoStack.empty()) undoStack.pop();
+        for (int epoch = 0; epoch < opt.epochs; ++epoch) {
+            reader.rewind(rng);
+            shuffle.clear();
+            bool exhausted = false;
+            long long epochCount = 0;
+            double epochLoss = 0;
+            while (true) {
+                // 填充小批量：缓冲区未满时先读满，之后每读入一条随机换出一条
+                int count = 0;
+                while (count < opt.batch) {
+                    TrainingSample s;
+                    bool got = !exhausted && reader.next(s);
+                    if (!got) exhausted = true;
+                    if (got && (int)shuffle.size() < opt.shuffleBuffer) { shuffle.push_back(std::move(s)); continue; }
+                    if (shuffle.empty()) break;
+                    int k = rng.below((int)shuffle.size());
+                    batch[count] = std::move(shuffle[k]);
+                    if (got) shuffle[k] = std::move(s);
+                    else { shuffle[k] = std::move(shuffle.back()); shuffle.pop_back(); }
+                    count++;
+                }
+                if (count == 0) break;
 
-                gameLoop();
-            } else if (choice == "2") {
-                string fname = view->getUserInput("输入文件名: ");
-                if (loadGame(fname)) {
-                    cout << "1. 继续游戏  2. 观看回放" << endl;
-                    if (view->getUserInput("> ") == "2") {
-                        replayMode();
-                    } else {
-                        gameLoop();
-                    }
-                } else {
-                    cout << "读取失败。" << endl;
+                vector<thread> workers;
+                for (int t = 0; t < T; ++t) {
+                    workers.emplace_back([&, t] {
+                        fill(grads[t].begin(), grads[t].end(), 0.0);
+                        losses[t] = 0;
+                        for (int i = t; i < count; i += T) losses[t] += accumulate(batch[i], w, diffs[t], grads[t]);
+                    });
+                }
+                for (auto& th : workers) th.join();
+
+                step++;
+                for (int c = 0; c < classCount; ++c) {
+                    double g = 0;
+                    for (int t = 0; t < T; ++t) g += grads[t][c];
+                    g = g / count + opt.l2 * (w[c] - prior[c]);
+                    m[c] = beta1 * m[c] + (1 - beta1) * g;
+                    v[c] = beta2 * v[c] + (1 - beta2) * g * g;
+                    double mh = m[c] / (1 - pow(beta1, (double)step));
+                    double vh = v[c] / (1 - pow(beta2, (double)step));
+                    w[c] -= opt.lr * mh / (sqrt(vh) + 1e-8);
                 }
+                for (int t = 0; t < T; ++t) epochLoss += losses[t];
+                epochCount += count;
             }
+            if (epochCount == 0) {
+                cerr << "分片中没有可用样本" << endl;
+                return 1;
+            }
+            seen += epochCount;
+            double secs = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+            cout << "epoch " << epoch + 1 << " step " << step << fixed << setprecision(5) << " loss " << epochLoss / epochCount
+                 << setprecision(0) << " (" << seen / max(secs, 1e-9) << " 样本/秒)" << endl;
+        }
+
+        vector<float> table((size_t)n * n);
+        for (int i = 0; i < n * n; ++i) table[i] = (float)w[classOf[i]];
+        if (!writeEvalWeights(opt.outPath, n, table)) {
+            cerr << "写入权值失败: " << opt.outPath << endl;
+            return 1;
         }
+        cout << "调优完成, 权值已写入 " << opt.outPath << endl;
+        return 0;
     }
+};
 
-    void gameLoop() {
-        bool running = true;
-        while (running) {
-            Player* p = (currentTurn == BLACK) ? playerBlack.get() : playerWhite.get();
-            string msg = "轮到 " + p->getName() + " (" + (currentTurn==BLACK?"黑":"白") + ")";
-            view->displayBoard(*board, currentTurn, msg);
+// --- NNUE 权值训练：用自对弈样本拟合 NnueEvaluator 的网络，量化后写出 NNU1 文件 ---
+// 浮点网络与推理同构：acc[视角] = B + Σ W[特征]，h = clamp(acc, 0, 1)，
+// z = Σ outW[行棋方]·h[行棋方] + Σ outW[对方]·h[对方] + outB，P(行棋方胜) = sigmoid(z)，最小化交叉熵。
+// 量化时累加器按 QA 倍存为 int16 (截断上限即 QA)，输出权值再乘 QB，评估分 = z · EVAL_WIN_SCALE；
+// 第一层权值限制在 [-1, 1]，19 路满盘的累加器也不会越出 int16
+struct NnueTrainOptions {
+    GameType type = REVERSI;
+    string outPath;
+    vector<string> inputs;   // 分片文件或目录
+    int epochs = 10;
+    int threads = 1;
+    int hidden = 32;
+    int batch = 256;
+    int shuffleBuffer = 100000;
+    float lr = 0.003f;       // Adam 步长
+};
 
-            if (rule->supportsPass()) {
-                if (!rule->hasValidMove(currentTurn)) {
-                    cout << "无子可下，被迫弃权 (Pass)!" << endl;
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-                    saveState();
-                    passCount++;
-                    moveHistory.push_back({-1, -1}); 
-                    if (passCount >= 2 || (gameType==REVERSI && board->countPieces(EMPTY)==0)) {
-                         goto GAME_OVER;
-                    }
-                    currentTurn = getOpponent(currentTurn);
-                    continue;
+class NnueTrainer {
+private:
+    static constexpr int QA = 64, QB = 64;
+    NnueTrainOptions opt;
+    int n, area, H;
+    // 参数连续存放：W[2*面积][H] | B[H] | outW[2H] | outB
+    vector<float> params;
+    size_t biasOffset, outOffset, outBiasOffset;
+
+    struct Workspace {
+        vector<int> features[2];
+        vector<float> acc[2];
+        vector<float> dacc;
+    };
+
+    // 单个样本的前向 + 反向，梯度累加到 grad，返回交叉熵
+    double trainSample(const TrainingSample& s, int sym, Workspace& ws, vector<float>& grad) const {
+        const float* W = params.data();
+        double z = params[outBiasOffset];
+        for (int side = 0; side < 2; ++side) {
+            PieceType perspective = side == 0 ? s.toMove : getOpponent(s.toMove);
+            vector<int>& features = ws.features[side];
+            vector<float>& acc = ws.acc[side];
+            features.clear();
+            acc.assign(params.begin() + biasOffset, params.begin() + biasOffset + H);
+            for (int x = 0; x < n; ++x)
+                for (int y = 0; y < n; ++y) {
+                    PieceType p = (PieceType)s.stones[x * n + y];
+                    if (p == EMPTY) continue;
+                    int f = NnueWeights::feature(perspective, symmetryIndex(sym, x, y, n), p);
+                    features.push_back(f);
+                    axpyF32(1.0f, W + (size_t)f * H, acc.data(), H);
                 }
+            for (int j = 0; j < H; ++j) z += params[outOffset + side * H + j] * min(max(acc[j], 0.0f), 1.0f);
+        }
+        double p = 1.0 / (1.0 + exp(-z));
+        double y = (s.result + 1.0) * 0.5;
+        float dz = (float)(p - y);
+        grad[outBiasOffset] += dz;
+        for (int side = 0; side < 2; ++side) {
+            const vector<float>& acc = ws.acc[side];
+            for (int j = 0; j < H; ++j) {
+                bool linear = acc[j] > 0 && acc[j] < 1;
+                grad[outOffset + side * H + j] += dz * min(max(acc[j], 0.0f), 1.0f);
+                ws.dacc[j] = linear ? dz * params[outOffset + side * H + j] : 0.0f;
             }
+            axpyF32(1.0f, ws.dacc.data(), grad.data() + biasOffset, H);
+            for (int f : ws.features[side]) axpyF32(1.0f, ws.dacc.data(), grad.data() + (size_t)f * H, H);
+        }
+        return -(y * log(max(p, 1e-12)) + (1 - y) * log(max(1 - p, 1e-12)));
+    }
 
-            Point move = p->getMove(*board, rule.get(), view.get());
+    NnueWeights quantize() const {
+        NnueWeights w;
+        w.area = area;
+        w.hidden = H;
+        w.clipMax = QA;
+        w.featureW.resize((size_t)2 * area * H);
+        for (size_t i = 0; i < w.featureW.size(); ++i) w.featureW[i] = (int16_t)lrintf(params[i] * QA);
+        w.featureB.resize(H);
+        for (int j = 0; j < H; ++j) w.featureB[j] = (int16_t)lrintf(params[biasOffset + j] * QA);
+        w.outW.resize((size_t)2 * H);
+        for (int j = 0; j < 2 * H; ++j)
+            w.outW[j] = (int16_t)max(-32767L, min(32767L, lrintf(params[outOffset + j] * QB)));
+        w.outB = (int32_t)lrintf(params[outBiasOffset] * QA * QB);
+        w.outScale = (float)(EVAL_WIN_SCALE / (QA * QB));
+        w.trained = true;
+        return w;
+    }
 
-            if (move.x == -2) { // Undo
-                if (undoStack.empty()) { cout << "无法悔棋" << endl; continue; }
-                GameState prev = undoStack.top(); undoStack.pop();
-                *board = prev.board; currentTurn = prev.currentPlayer; passCount = prev.passCount; moveHistory = prev.moveHistory;
-                continue;
-            }
-            if (move.x == -3) { // Save
-                string fname = view->getUserInput("输入文件名: ");
-                saveGame(fname);
-                continue;
-            }
-            if (move.x == -4) { // Quit
-                running = false; break;
-            }
-            if (move.x == -1) { // Manual Pass
-                if (gameType != GO) { cout << "此游戏不支持主动虚着" << endl; continue; }
-                saveState();
-                passCount++;
-                moveHistory.push_back({-1, -1});
-                currentTurn = getOpponent(currentTurn);
-                if (passCount >= 2) goto GAME_OVER;
-                continue;
-            }
+public:
+    explicit NnueTrainer(const NnueTrainOptions& o)
+        : opt(o), n(boardSizeFor(o.type)), area(n * n), H(max(1, min(o.hidden, NnueWeights::MAX_HIDDEN))) {
+        biasOffset = (size_t)2 * area * H;
+        outOffset = biasOffset + H;
+        outBiasOffset = outOffset + 2 * H;
+        params.assign(outBiasOffset + 1, 0.0f);
+    }
 
-            if (rule->isValidMove(move.x, move.y, currentTurn)) {
-                saveState();
-                rule->makeMove(move.x, move.y, currentTurn);
-                moveHistory.push_back(move);
-                passCount = 0;
-                
-                GameStatus status = rule->checkWin(move.x, move.y);
-                
-                if (gameType == REVERSI) {
-                    if (board->countPieces(EMPTY) == 0 || 
-                        board->countPieces(BLACK) == 0 || 
-                        board->countPieces(WHITE) == 0) {
-                        status = rule->checkWin(move.x, move.y); 
-                    } else if (!rule->hasValidMove(BLACK) && !rule->hasValidMove(WHITE)) {
-                         status = rule->checkWin(move.x, move.y);
-                    }
+    int run() {
+        vector<string> files = listShardFiles(opt.inputs);
+        if (files.empty()) {
+            cerr << "没有找到样本分片 (.spd)" << endl;
+            return 1;
+        }
+        ShardReader reader(files, opt.type);
+        FastRandom rng((uint64_t)time(0));
+        mt19937 gen((uint32_t)rng.next());
+        normal_distribution<float> first(0.0f, 0.05f), out(0.0f, 0.1f);
+        for (size_t i = 0; i < biasOffset; ++i) params[i] = first(gen);
+        for (int j = 0; j < H; ++j) params[biasOffset + j] = 0.5f; // 初始落在截断区间中部
+        for (int j = 0; j < 2 * H; ++j) params[outOffset + j] = out(gen);
+
+        int T = max(1, opt.threads);
+        vector<Workspace> spaces(T);
+        for (auto& ws : spaces) ws.dacc.assign(H, 0.0f);
+        vector<vector<float>> grads(T, vector<float>(params.size()));
+        vector<double> losses(T);
+        vector<float> m(params.size(), 0.0f), v(params.size(), 0.0f);
+        const double beta1 = 0.9, beta2 = 0.999;
+        vector<TrainingSample> shuffle;   // 洗牌缓冲区
+        vector<TrainingSample> batch(opt.batch);
+        vector<int> syms(opt.batch);
+        auto startTime = chrono::steady_clock::now();
+        long long seen = 0, step = 0;
+
+        for (int epoch = 0; epoch < opt.epochs; ++epoch) {
+            reader.rewind(rng);
+            shuffle.clear();
+            bool exhausted = false;
+            long long epochCount = 0;
+            double epochLoss = 0;
+            while (true) {
+                // 填充小批量：缓冲区未满时先读满，之后每读入一条随机换出一条
+                int count = 0;
+                while (count < opt.batch) {
+                    TrainingSample s;
+                    bool got = !exhausted && reader.next(s);
+                    if (!got) exhausted = true;
+                    if (got && (int)shuffle.size() < opt.shuffleBuffer) { shuffle.push_back(std::move(s)); continue; }
+                    if (shuffle.empty()) break;
+                    int k = rng.below((int)shuffle.size());
+                    batch[count] = std::move(shuffle[k]);
+                    if (got) shuffle[k] = std::move(s);
+                    else { shuffle[k] = std::move(shuffle.back()); shuffle.pop_back(); }
+                    syms[count] = rng.below(8); // 随机对称增强
+                    count++;
                 }
+                if (count == 0) break;
 
-                if (status != PLAYING) {
-                    view->displayBoard(*board, currentTurn, "游戏结束!");
-                    if (status == BLACK_WIN) {
-                        cout << "黑方获胜!" << endl;
-                        if (!playerBlack->isAI()) userMgr->recordGameResult(true);
-                        if (!playerWhite->isAI()) userMgr->recordGameResult(false);
-                    } else if (status == WHITE_WIN) {
-                        cout << "白方获胜!" << endl;
-                        if (!playerWhite->isAI()) userMgr->recordGameResult(true);
-                        if (!playerBlack->isAI()) userMgr->recordGameResult(false);
-                    } else {
-                        cout << "平局!" << endl;
-                        if (!playerBlack->isAI()) userMgr->recordGameResult(false);
-                        if (!playerWhite->isAI()) userMgr->recordGameResult(false);
-                    }
-                    running = false;
-                    view->getUserInput("按回车返回...");
-                } else {
-                    currentTurn = getOpponent(currentTurn);
+                vector<thread> workers;
+                for (int t = 0; t < T; ++t) {
+                    workers.emplace_back([&, t] {
+                        fill(grads[t].begin(), grads[t].end(), 0.0f);
+                        losses[t] = 0;
+                        for (int i = t; i < count; i += T) losses[t] += trainSample(batch[i], syms[i], spaces[t], grads[t]);
+                    });
                 }
-            } else {
-                if (!p->isAI()) cout << "落子不合法!" << endl;
+                for (auto& th : workers) th.join();
+
+                step++;
+                for (int t = 1; t < T; ++t) axpyF32(1.0f, grads[t].data(), grads[0].data(), (int)grads[0].size());
+                double c1 = 1 - pow(beta1, (double)step), c2 = 1 - pow(beta2, (double)step);
+                for (size_t i = 0; i < params.size(); ++i) {
+                    float g = grads[0][i] / count;
+                    m[i] = (float)(beta1 * m[i] + (1 - beta1) * g);
+                    v[i] = (float)(beta2 * v[i] + (1 - beta2) * g * g);
+                    params[i] -= (float)(opt.lr * (m[i] / c1) / (sqrt(v[i] / c2) + 1e-8));
+                }
+                for (size_t i = 0; i < outOffset; ++i) params[i] = min(max(params[i], -1.0f), 1.0f);
+                for (int t = 0; t < T; ++t) epochLoss += losses[t];
+                epochCount += count;
+            }
+            if (epochCount == 0) {
+                cerr << "分片中没有可用样本" << endl;
+                return 1;
             }
+            seen += epochCount;
+            double secs = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+            cout << "epoch " << epoch + 1 << " step " << step << fixed << setprecision(5) << " loss " << epochLoss / epochCount
+                 << setprecision(0) << " (" << seen / max(secs, 1e-9) << " 样本/秒)" << endl;
         }
-        return;
 
-    GAME_OVER:
-        view->displayBoard(*board, currentTurn, "游戏结束 (双人虚着/无子可下)!");
-        float bScore = 0, wScore = 0;
-        rule->calculateScore(bScore, wScore);
-        cout << fixed << setprecision(2);
-        cout << "黑方: " << bScore << ", 白方: " << wScore << endl;
-        if (bScore > wScore) {
-            cout << "黑方获胜!" << endl;
-            if (!playerBlack->isAI()) userMgr->recordGameResult(true);
-        } else {
-            cout << "白方获胜!" << endl;
-            if (!playerWhite->isAI()) userMgr->recordGameResult(true);
+        if (!quantize().save(opt.outPath)) {
+            cerr << "写入权值失败: " << opt.outPath << endl;
+            return 1;
         }
-        view->getUserInput("按回车返回...");
+        cout << "训练完成, NNUE 权值已写入 " << opt.outPath << endl;
+        return 0;
     }
+};
 
-    void replayMode() {
-        board->clear();
-        rule->initBoard();
-        
-        cout << "=== 进入回放模式 ===" << endl;
-        cout << "总步数: " << moveHistory.size() << endl;
-        
-        PieceType p = BLACK;
-        for (size_t i = 0; i < moveHistory.size(); ++i) {
-            view->displayBoard(*board, p, "回放中... (回车下一步, q退出)");
-            string cmd = view->getUserInput("");
-            if (cmd == "q") break;
-
-            Point m = moveHistory[i];
-            if (m.x == -1) {
-                cout << "Step " << i+1 << ": Pass" << endl;
-            } else {
-                rule->makeMove(m.x, m.y, p);
-            }
-            p = getOpponent(p);
-        }
-        cout << "回放结束。" << endl;
-        view->getUserInput("按回车返回...");
+// --- 死活题批量求解 ---
+// 题目文件：每题一行题头，随后 <尺寸> 行棋盘 (. 空 / X 黑 / O 白)，# 开头为注释
+//   problem <名称> <尺寸> <先走方 B|W> <目标行> <目标列> [kill|live]
+// 末尾给出期望结论时核对答案；全部相符 (或未给期望) 返回 0
+int solveTsumegoFile(const string& path, long nodeLimit) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "无法打开题目文件: " << path << endl;
+        return 1;
     }
-
-    void saveGame(string filename) {
-        ofstream file(filename);
-        file << (int)gameType << " " << (int)currentTurn << " " << passCount << endl;
-        file << board->serialize() << endl;
-        file << moveHistory.size() << endl;
-        for(auto p : moveHistory) file << p.x << " " << p.y << " ";
-        file.close();
-        cout << "存档成功!" << endl;
+    TsumegoSolver solver;
+    string line;
+    int solved = 0, total = 0, wrong = 0;
+    while (getline(in, line)) {
+        istringstream head(line);
+        string word, name, side, expect;
+        int size = 0, tx = 0, ty = 0;
+        if (!(head >> word) || word != "problem") continue;
+        if (!(head >> name >> size >> side >> tx >> ty) || size < 2 || size > Board::MAX_SIZE) {
+            cerr << "题头格式错误: " << line << endl;
+            return 1;
+        }
+        head >> expect;
+        Board board(size);
+        for (int i = 0; i < size; ++i) {
+            string row;
+            if (!getline(in, row)) row.clear();
+            for (int j = 0; j < size && j < (int)row.size(); ++j)
+                board.setPiece(i, j, row[j] == 'X' ? BLACK : (row[j] == 'O' ? WHITE : EMPTY));
+        }
+        PieceType toMove = (side == "W" || side == "w") ? WHITE : BLACK;
+        TsumegoSolver::Result r = solver.solve(board, {tx, ty}, toMove, nodeLimit);
+        total++;
+        if (r.outcome != TsumegoSolver::UNKNOWN) solved++;
+        const char* verdict = r.outcome == TsumegoSolver::KILLED ? "kill"
+                            : (r.outcome == TsumegoSolver::ALIVE ? "live" : "unknown");
+        cout << name << ": " << verdict;
+        if (r.move.x >= 0) cout << " (" << r.move.x << ", " << r.move.y << ")";
+        cout << "  节点 " << r.nodes << "  " << fixed << setprecision(2) << r.ms << " ms";
+        if (!expect.empty()) {
+            bool ok = expect == verdict;
+            if (!ok) wrong++;
+            cout << (ok ? "  [正确]" : "  [错误]");
+        }
+        cout << endl;
     }
+    cout << "共 " << total << " 题, 解出 " << solved << " 题";
+    if (wrong > 0) cout << ", 与期望不符 " << wrong << " 题";
+    cout << endl;
+    return wrong == 0 ? 0 : 1;
+}
 
-    bool loadGame(string filename) {
-        ifstream file(filename);
-        if (!file.is_open()) return false;
-        int gt, ct;
-        file >> gt >> ct >> passCount;
-        gameType = (GameType)gt;
-        currentTurn = (PieceType)ct;
-        
-        stringstream ss;
-        string dummy; getline(file, dummy); 
-        string boardStr; getline(file, boardStr);
-        ss << boardStr;
-        
-        int size;
-        if (gameType == REVERSI) size = 8;
-        else if (gameType == GO) size = 19;
-        else size = 15;
-        
-        board = make_unique<Board>(size); 
-        board->deserialize(ss); 
-        
-        if (gameType == GOMOKU) rule = make_unique<GomokuRule>(board.get());
-        else if (gameType == GO) rule = make_unique<GoRule>(board.get());
-        else rule = make_unique<ReversiRule>(board.get());
+void printUsage() {
+    cout << "用法:" << endl;
+    cout << "  HW2                                      进入交互式对战平台" << endl;
+    cout << "  HW2 selfplay <gomoku|go|reversi> <局数> <输出目录> [并发对局数] [每步模拟次数]" << endl;
+    cout << "            [--resign 认输胜率阈值] [--no-adjudicate]" << endl;
+    cout << "  HW2 train <gomoku|go|reversi> <模型文件> <分片文件或目录...> [--epochs N] [--threads N]" << endl;
+    cout << "            [--channels C] [--layers L] [--batch B] [--lr X] [--calib-pct P]" << endl;
+    cout << "  HW2 tune reversi <分片文件或目录...> [--out 权值文件] [--epochs N] [--threads N] [--batch B] [--lr X]" << endl;
+    cout << "  HW2 train-nnue <gomoku|reversi> <分片文件或目录...> [--out 权值文件] [--epochs N] [--threads N]" << endl;
+    cout << "            [--hidden H] [--batch B] [--lr X]" << endl;
+    cout << "  HW2 tsumego <题目文件> [--nodes N]" << endl;
+    cout << "  HW2 --shared-tt <MB> [以上任一用法]        与同机其他进程共用置换表 (POSIX 共享内存)" << endl;
+}
 
-        int histSize;
-        file >> histSize;
-        moveHistory.clear();
-        for(int i=0; i<histSize; ++i) {
-            int x, y; file >> x >> y;
-            moveHistory.push_back({x, y});
+// 命令行工具入口，返回进程退出码
+int runCommandLine(int argc, char** argv) {
+    string cmd = argv[1];
+    if (cmd == "selfplay" && argc >= 5) {
+        SelfPlayOptions opt;
+        opt.type = parseGameType(argv[2]);
+        opt.games = atoi(argv[3]);
+        opt.outDir = argv[4];
+        opt.workers = (int)max(1u, thread::hardware_concurrency());
+        vector<string> positional;
+        for (int i = 5; i < argc; ++i) {
+            string a = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (a == "--resign" && hasValue) opt.adjudication.resignThreshold = atof(argv[++i]);
+            else if (a == "--no-adjudicate") opt.adjudicate = false;
+            else positional.push_back(a);
         }
-        
-        setupPlayers(1, userMgr->getCurrentUsername()); 
-        
-        return true;
+        if (positional.size() > 0) opt.workers = atoi(positional[0].c_str());
+        if (positional.size() > 1) opt.playouts = atoi(positional[1].c_str());
+        return SelfPlayRunner(opt).run();
     }
-};
+    if (cmd == "train" && argc >= 5) {
+        TrainOptions opt;
+        opt.type = parseGameType(argv[2]);
+        opt.modelPath = argv[3];
+        opt.threads = (int)max(1u, thread::hardware_concurrency());
+        for (int i = 4; i < argc; ++i) {
+            string a = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (a == "--epochs" && hasValue) opt.epochs = atoi(argv[++i]);
+            else if (a == "--threads" && hasValue) opt.threads = atoi(argv[++i]);
+            else if (a == "--channels" && hasValue) opt.channels = atoi(argv[++i]);
+            else if (a == "--layers" && hasValue) opt.layers = atoi(argv[++i]);
+            else if (a == "--batch" && hasValue) opt.batch = atoi(argv[++i]);
+            else if (a == "--lr" && hasValue) opt.lr = (float)atof(argv[++i]);
+            else if (a == "--calib-pct" && hasValue) opt.calibrationPercentile = atof(argv[++i]);
+            else opt.inputs.push_back(a);
+        }
+        return Trainer(opt).run();
+    }
+    if (cmd == "tune" && argc >= 4) {
+        TuneOptions opt;
+        opt.type = parseGameType(argv[2]);
+        if (opt.type != REVERSI) {
+            cerr << "tune 只支持黑白棋：五子棋与围棋的逐格权值拟合不出有意义的评估" << endl;
+            return 1;
+        }
+        opt.outPath = evalWeightsFileName(opt.type, boardSizeFor(opt.type));
+        opt.threads = (int)max(1u, thread::hardware_concurrency());
+        for (int i = 3; i < argc; ++i) {
+            string a = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (a == "--out" && hasValue) opt.outPath = argv[++i];
+            else if (a == "--epochs" && hasValue) opt.epochs = atoi(argv[++i]);
+            else if (a == "--threads" && hasValue) opt.threads = atoi(argv[++i]);
+            else if (a == "--batch" && hasValue) opt.batch = atoi(argv[++i]);
+            else if (a == "--lr" && hasValue) opt.lr = (float)atof(argv[++i]);
+            else opt.inputs.push_back(a);
+        }
+        return EvalTuner(opt).run();
+    }
+    if (cmd == "train-nnue" && argc >= 4) {
+        NnueTrainOptions opt;
+        opt.type = parseGameType(argv[2]);
+        if (opt.type == GO) {
+            cerr << "train-nnue 只支持五子棋与黑白棋 (围棋不用 alpha-beta 搜索)" << endl;
+            return 1;
+        }
+        opt.outPath = nnueFileName(opt.type, boardSizeFor(opt.type));
+        opt.threads = (int)max(1u, thread::hardware_concurrency());
+        for (int i = 3; i < argc; ++i) {
+            string a = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (a == "--out" && hasValue) opt.outPath = argv[++i];
+            else if (a == "--epochs" && hasValue) opt.epochs = atoi(argv[++i]);
+            else if (a == "--threads" && hasValue) opt.threads = atoi(argv[++i]);
+            else if (a == "--hidden" && hasValue) opt.hidden = atoi(argv[++i]);
+            else if (a == "--batch" && hasValue) opt.batch = atoi(argv[++i]);
+            else if (a == "--lr" && hasValue) opt.lr = (float)atof(argv[++i]);
+            else opt.inputs.push_back(a);
+        }
+        return NnueTrainer(opt).run();
+    }
+    if (cmd == "tsumego" && argc >= 3) {
+        long nodeLimit = 200000;
+        for (int i = 3; i + 1 < argc; ++i)
+            if (string(argv[i]) == "--nodes") nodeLimit = atol(argv[++i]);
+        return solveTsumegoFile(argv[2], nodeLimit);
+    }
+    printUsage();
+    return 1;
+}
 
-int main() {
+int main(int argc, char** argv) {
+    // 全局选项须放在最前：--shared-tt MB 挂接 (不存在时创建) 各进程共用的置换表
+    if (argc > 2 && string(argv[1]) == "--shared-tt") {
+        if (openSharedTable((size_t)max(1, atoi(argv[2])))) cout << "已挂接共享置换表 " << (sharedTable()->bytes() >> 20) << " MB" << endl;
+        else cerr << "无法挂接共享置换表 (已有的段大小、版本或构建不同；确认没有进程在用后可删除 /dev/shm/hw2-shared-tt)，按单进程运行" << endl;
+        argv[2] = argv[0];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc > 1) return runCommandLine(argc, argv);
     GameManager game;
     game.run();
     return 0;